@@ -74,7 +74,6 @@
 #define configUSE_MALLOC_FAILED_HOOK                1
 #define configUSE_APPLICATION_TASK_TAG              0
 #define configUSE_COUNTING_SEMAPHORES               1
-#define configGENERATE_RUN_TIME_STATS               0
 #define configENABLE_FPU                            1
 #define configENABLE_MPU                            0
 #define configENABLE_TRUSTZONE                      0
@@ -104,6 +103,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelay              1
 #define INCLUDE_xTaskIsTaskFinished     1
 #define INCLUDE_xTimerPendFunctionCall  1
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
 
 /*
 Interrupt nesting behavior configuration.
@@ -174,6 +174,18 @@ extern void vApplicationSleep( uint32_t xExpectedIdleTime );
 #define configUSE_TICKLESS_IDLE  2
 #endif
 
+/* Run-time statistics, backed by a 1 MHz timer in source/rtos_stats.c. Only
+ * built with RTOS_STATS=1: the counter is read on every context switch. */
+#if defined(ENABLE_RTOS_STATS)
+#define configGENERATE_RUN_TIME_STATS               1
+extern void rtos_stats_timer_init( void );
+extern uint32_t rtos_stats_timer_read( void );
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()    rtos_stats_timer_init()
+#define portGET_RUN_TIME_COUNTER_VALUE()            rtos_stats_timer_read()
+#else
+#define configGENERATE_RUN_TIME_STATS               0
+#endif
+
 /* Deep Sleep Latency Configuration */
 #if CY_CFG_PWR_DEEPSLEEP_LATENCY > 0
 #define configEXPECTED_IDLE_TIME_BEFORE_SLEEP   CY_CFG_PWR_DEEPSLEEP_LATENCY
@@ -98,6 +98,16 @@ extern "C" {
  */
 #define CY_OTA_MQTT_TIMEOUT_MS              (5000)              /* 5 second timeout waiting for MQTT response */
 
+/**
+ * @brief Image data in each MQTT payload of the publisher
+ *
+ * Must match CHUNK_SIZE of scripts/mqtt_ota_publisher.py and scripts/ota_package.py.
+ * source/ota_tls.c checks at build time that a whole chunk fits in one TLS record.
+ */
+#ifndef CY_OTA_CHUNK_SIZE
+#define CY_OTA_CHUNK_SIZE                   (4 * 1024)          /* 4 KB of image per payload */
+#endif
+
 
 #ifdef __cplusplus
     }
@@ -95,13 +95,29 @@
 
 /**
  * @brief Memory allocation. This function should have the same signature as [malloc](http://pubs.opengroup.org/onlinepubs/9699919799/functions/malloc.html)
+ * With IOT_POOL_ALLOCATOR, small requests are served from the size-class pools of source/iot_pool.c.
+ * With HEAP_TRACE, every allocation is also logged by source/heap_trace.c.
  */
+#if defined(HEAP_TRACE)
+#include "heap_trace.h"
+#define Iot_DefaultMalloc                           heap_trace_iot_malloc
+#elif defined(IOT_POOL_ALLOCATOR)
+#include "iot_pool.h"
+#define Iot_DefaultMalloc                           iot_pool_malloc
+#else
 #define Iot_DefaultMalloc                           malloc
+#endif
 
 /**
  * @brief Free memory. This function should have the same signature as [free](http://pubs.opengroup.org/onlinepubs/9699919799/functions/free.html)
  */
+#if defined(HEAP_TRACE)
+#define Iot_DefaultFree                             heap_trace_iot_free
+#elif defined(IOT_POOL_ALLOCATOR)
+#define Iot_DefaultFree                             iot_pool_free
+#else
 #define Iot_DefaultFree                             free
+#endif
 
 /**
  * \cond
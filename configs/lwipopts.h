@@ -197,8 +197,11 @@
 
 /**
  * MEMP_NUM_SYS_TIMEOUT: the number of simultaneously active timeouts.
+ * One is used by the application to release the gateway ARP entry that is
+ * pre-seeded from a saved lease, and two by the broker address cache for its
+ * refresh and resolve timers.
  */
-#define MEMP_NUM_SYS_TIMEOUT            12
+#define MEMP_NUM_SYS_TIMEOUT            15
 
 /**
  * PBUF_POOL_SIZE: the number of buffers in the pbuf pool.
@@ -245,6 +248,14 @@
 
 #define LWIP_DNS                        (1)
 
+/**
+ * The broker address cache installs the resolved IPv4 and IPv6 addresses of
+ * the MQTT broker in the local host list so lookups need no round trip.
+ */
+#define DNS_LOCAL_HOSTLIST              (1)
+#define DNS_LOCAL_HOSTLIST_IS_DYNAMIC   (1)
+#define MEMP_NUM_LOCALHOSTLIST          (2)
+
 #define LWIP_NETIF_TX_SINGLE_PBUF       (1)
 
 #define LWIP_RAND                       rand
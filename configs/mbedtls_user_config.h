@@ -129,8 +129,20 @@
  *      MBEDTLS_TLS_PSK_WITH_CAMELLIA_128_CBC_SHA256
  *      MBEDTLS_TLS_PSK_WITH_3DES_EDE_CBC_SHA
  *      MBEDTLS_TLS_PSK_WITH_RC4_128_SHA
+ *
+ * Enabled alone when TLS_KEY_EXCHANGE is PSK in the Makefile. ECDHE_PSK
+ * enables the ECDHE-PSK key exchange alone, so the image sizes of the two
+ * compare one key exchange each.
  */
+#if defined(OTA_TLS_PSK_PLAIN)
+#define MBEDTLS_KEY_EXCHANGE_PSK_ENABLED
+#undef MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED
+#elif defined(OTA_TLS_PSK)
+#undef MBEDTLS_KEY_EXCHANGE_PSK_ENABLED
+#define MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED
+#else
 #undef MBEDTLS_KEY_EXCHANGE_PSK_ENABLED
+#endif
 
 
 /**
@@ -345,9 +357,12 @@
  * tickets, including authenticated encryption and key management. Example
  * callbacks are provided by MBEDTLS_SSL_TICKET_C.
  *
+ * Enabled so that the OTA MQTT connection can be resumed with a ticket; the
+ * session store is in source/ota_tls.c.
+ *
  * Comment this macro to disable support for SSL session tickets
  */
-#undef MBEDTLS_SSL_SESSION_TICKETS
+#define MBEDTLS_SSL_SESSION_TICKETS
 
 /**
  * \def MBEDTLS_SSL_EXPORT_KEYS
@@ -487,4 +502,71 @@
  */
 #define MBEDTLS_TLS_DEFAULT_ALLOW_SHA1_IN_CERTIFICATES
 
+/**
+ * \def MBEDTLS_SSL_IN_CONTENT_LEN
+ *
+ * Size of the record buffer for incoming data, set by TLS_MAX_RECORD_LEN in
+ * the Makefile. source/ota_tls.c requests the matching Max Fragment Length
+ * from the broker so that no larger record is sent.
+ */
+#if defined(OTA_TLS_MAX_RECORD_LEN)
+#define MBEDTLS_SSL_IN_CONTENT_LEN              OTA_TLS_MAX_RECORD_LEN
+#endif
+
+/**
+ * \def MBEDTLS_SSL_OUT_CONTENT_LEN
+ *
+ * Size of the record buffer for outgoing data. The device only sends its
+ * certificate and small MQTT packets; longer writes are split into records.
+ */
+#define MBEDTLS_SSL_OUT_CONTENT_LEN             4096
+
+/**
+ * ECC and cipher suite profile, set by TLS_PROFILE in the Makefile. Without
+ * one (DEFAULT), the mbedTLS settings and cipher suites are left as they are.
+ *
+ * SPEED: 6-bit window for the scalar multiplications, comb tables for the
+ *        fixed base point (the ECDHE key generation and ECDSA signing) and
+ *        NIST fast reduction, as mbedTLS does by default, and only AES-128-GCM
+ *        suites with ECDHE. The ECDHE-RSA suite is kept for brokers with an
+ *        RSA certificate, such as test.mosquitto.org.
+ * SIZE:  2-bit window without comb tables or fast reduction; less RAM per
+ *        handshake and less flash, but a slower handshake.
+ */
+#if defined(OTA_TLS_PROFILE_SIZE)
+#define MBEDTLS_ECP_WINDOW_SIZE                 2
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM           0
+#undef MBEDTLS_ECP_NIST_OPTIM
+#elif defined(OTA_TLS_PROFILE_SPEED)
+#define MBEDTLS_ECP_WINDOW_SIZE                 6
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM           1
+#define MBEDTLS_ECP_NIST_OPTIM
+#define MBEDTLS_SSL_CIPHERSUITES                MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256, \
+                                                MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256
+#endif
+
+/**
+ * \def MBEDTLS_PLATFORM_MEMORY
+ *
+ * Lets source/ecc_bench.c count the allocations of mbedTLS to report the peak
+ * heap of the ECC operations. Only in builds with ECC_BENCHMARK=1.
+ */
+#if defined(ENABLE_ECC_BENCHMARK)
+#define MBEDTLS_PLATFORM_MEMORY
+#endif
+
+/*
+ * Cipher suites of the PSK key exchanges, in place of those of the ECC
+ * profile. PSK skips all ECC work; ECDHE-PSK adds forward secrecy for one
+ * ECDHE exchange, still without certificates.
+ */
+#if defined(OTA_TLS_PSK_PLAIN)
+#undef MBEDTLS_SSL_CIPHERSUITES
+#define MBEDTLS_SSL_CIPHERSUITES                MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256, \
+                                                MBEDTLS_TLS_PSK_WITH_AES_128_CBC_SHA256
+#elif defined(OTA_TLS_PSK)
+#undef MBEDTLS_SSL_CIPHERSUITES
+#define MBEDTLS_SSL_CIPHERSUITES                MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256
+#endif
+
 #endif /* MBEDTLS_USER_CONFIG_HEADER */
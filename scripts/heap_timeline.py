@@ -0,0 +1,137 @@
+import re
+import shutil
+import subprocess
+import sys
+
+# Rebuilds the heap of a device from the serial log of a HEAP_TRACE=1 build:
+#   python heap_timeline.py serial.log [app.elf]
+# Prints the peak of the live heap and the callers owning it at that moment,
+# and, if matplotlib is installed, plots the live heap over time and the
+# owners at the peak. With the ELF file, callers are shown as functions.
+# A log may hold several boots; each one starting at "HT BOOT" is a run, and
+# RUN selects the one analyzed (0 is the first, -1 the last).
+RUN = 0
+TOP_CALLERS = 15
+ADDR2LINE = "arm-none-eabi-addr2line"
+TIMELINE_FILE = "heap_timeline.png"
+OWNERS_FILE = "heap_owners.png"
+
+RECORD = re.compile(r"HT ([0-9a-f]{8}) ([0-9a-f]{8}) ([0-9a-f]{8}) ([0-9a-f]{8})")
+DROP = re.compile(r"HT DROP (\d+)")
+
+ALLOC_KINDS = "MCRPIB"
+POOL_KIND = "B"     # Pool block of source/iot_pool.c, not heap memory
+FREE_KIND = "F"
+FAILED_KIND = "X"
+
+def read_runs(path):
+    runs = [[]]
+    with open(path, errors="replace") as log:
+        for line in log:
+            if "HT BOOT" in line and runs[-1]:
+                runs.append([])
+            match = DROP.search(line)
+            if match:
+                print("Warning: {} records dropped, the live heap is approximate".format(match.group(1)))
+                continue
+            match = RECORD.search(line)
+            if match:
+                time_ms, size_kind, ptr, caller = (int(word, 16) for word in match.groups())
+                runs[-1].append((time_ms, chr(size_kind >> 24), size_kind & 0xFFFFFF, ptr, caller))
+    return runs
+
+def replay(records):
+    # Live blocks as {pointer: (size, caller, kind)}; returns the timeline,
+    # the owners at the peak and the failed allocations
+    live = {}
+    heap = 0
+    pool = 0
+    timeline = []
+    peak = (0, 0, {})
+    failures = []
+    for time_ms, kind, size, ptr, caller in records:
+        if kind in ALLOC_KINDS:
+            live[ptr] = (size, caller, kind)
+            if kind == POOL_KIND:
+                pool += size
+            else:
+                heap += size
+        elif kind == FREE_KIND and ptr in live:
+            size, _, old_kind = live.pop(ptr)
+            if old_kind == POOL_KIND:
+                pool -= size
+            else:
+                heap -= size
+        elif kind == FAILED_KIND:
+            failures.append((time_ms, size, caller, heap))
+        timeline.append((time_ms / 1000.0, heap, pool))
+        if heap > peak[1]:
+            owners = {}
+            for block_size, block_caller, block_kind in live.values():
+                if block_kind != POOL_KIND:
+                    owners[block_caller] = owners.get(block_caller, 0) + block_size
+            peak = (time_ms, heap, owners)
+    return timeline, peak, failures
+
+def symbolize(callers, elf):
+    # Return addresses point past the call; the Thumb bit is set
+    names = {caller: "0x{:08x}".format(caller) for caller in callers}
+    if elf is None or shutil.which(ADDR2LINE) is None:
+        return names
+    addresses = ["0x{:x}".format(max(caller - 1, 0) & ~1) for caller in callers]
+    output = subprocess.run([ADDR2LINE, "-f", "-s", "-e", elf] + addresses,
+                            capture_output=True, text=True).stdout.splitlines()
+    for i, caller in enumerate(callers):
+        if 2 * i + 1 < len(output):
+            names[caller] = "{} ({})".format(output[2 * i], output[2 * i + 1])
+    return names
+
+def plot(timeline, owners, names):
+    try:
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print("matplotlib not installed, no plots")
+        return
+    times = [t for t, _, _ in timeline]
+    plt.figure(figsize=(12, 5))
+    plt.step(times, [h / 1024.0 for _, h, _ in timeline], where="post", label="heap")
+    plt.step(times, [p / 1024.0 for _, _, p in timeline], where="post", label="IoT pool blocks")
+    plt.xlabel("Uptime (s)")
+    plt.ylabel("Live (KB)")
+    plt.legend()
+    plt.tight_layout()
+    plt.savefig(TIMELINE_FILE)
+    print("Saved " + TIMELINE_FILE)
+
+    plt.figure(figsize=(12, 6))
+    labels = [names[caller] for caller, _ in owners]
+    plt.barh(labels[::-1], [size / 1024.0 for _, size in owners][::-1])
+    plt.xlabel("Live at the peak (KB)")
+    plt.tight_layout()
+    plt.savefig(OWNERS_FILE)
+    print("Saved " + OWNERS_FILE)
+    plt.show()
+
+if len(sys.argv) < 2:
+    print("usage: heap_timeline.py LOG [ELF]")
+    sys.exit(1)
+
+elf = sys.argv[2] if len(sys.argv) > 2 else None
+runs = [run for run in read_runs(sys.argv[1]) if run]
+if not runs:
+    print("No heap trace records in " + sys.argv[1])
+    sys.exit(1)
+print("{} run(s) in the log, analyzing run {}".format(len(runs), RUN))
+
+timeline, (peak_ms, peak_bytes, owners), failures = replay(runs[RUN])
+owners = sorted(owners.items(), key=lambda item: item[1], reverse=True)[:TOP_CALLERS]
+names = symbolize([caller for caller, _ in owners] + [caller for _, _, caller, _ in failures], elf)
+
+print("Peak live heap: {} bytes at {:.3f} s".format(peak_bytes, peak_ms / 1000.0))
+for caller, size in owners:
+    print("  {:>8}  {}".format(size, names[caller]))
+for time_ms, size, caller, heap in failures:
+    print("Failed allocation of {} bytes at {:.3f} s by {}, {} bytes live".format(
+          size, time_ms / 1000.0, names[caller], heap))
+
+plot(timeline, owners, names)
@@ -0,0 +1,103 @@
+import hashlib
+import struct
+import sys
+
+# Checks that a signed image only holds its populated region, header + image
+# + TLVs, and estimates what that saves at boot against a copy of the whole
+# slot:
+#   python image_extent.py IMAGE.bin [SLOT_SIZE [MODE]]
+# MODE is MCUBOOT_UPGRADE_MODE of the Makefile. Run after the sign script;
+# the build fails when the image is padded, does not fit the slot, or its
+# SHA-256 does not match. The timings must match scripts/swap_bench.py.
+SECTOR_SIZE = 512               # Row of the internal flash
+ERASE_US = 11000                # Row erase
+PROGRAM_US = 5000               # Row program after erase
+HASH_US_PER_KB = 2000           # SHA-256 on the CM0+ of MCUboot, ~100 cycles/byte at 50 MHz
+READ_US_PER_KB = 10
+ERASE_VALUE = 0x00              # CY_FLASH_ERASE_VALUE
+
+SLOT_SIZE = 0xEE000             # CY_BOOT_PRIMARY_1_SIZE
+TRAILER_SECTORS = 1
+
+IMAGE_MAGIC = 0x96F3B83D
+TLV_INFO_MAGIC = 0x6907
+TLV_PROT_INFO_MAGIC = 0x6908
+TLV_SHA256 = 0x10
+
+def sectors(size):
+    return (size + SECTOR_SIZE - 1) // SECTOR_SIZE
+
+def parse(image):
+    magic, _, hdr_size, protect_tlv_size, img_size = struct.unpack_from("<IIHHI", image, 0)
+    if magic != IMAGE_MAGIC:
+        raise ValueError("no MCUboot header")
+    offset = hdr_size + img_size
+    hashed = offset + protect_tlv_size
+    tlvs = {}
+    for info_magic in (TLV_PROT_INFO_MAGIC, TLV_INFO_MAGIC):
+        magic, total = struct.unpack_from("<HH", image, offset)
+        if magic != info_magic:
+            if info_magic == TLV_PROT_INFO_MAGIC:
+                continue
+            raise ValueError("no TLV area at 0x{:x}".format(offset))
+        end = offset + total
+        offset += 4
+        while offset < end:
+            tlv_type, tlv_len = struct.unpack_from("<HH", image, offset)
+            tlvs[tlv_type & 0xFF] = image[offset + 4:offset + 4 + tlv_len]
+            offset += 4 + tlv_len
+    return hashed, offset, tlvs
+
+def copy_us(length):
+    return sectors(length) * (ERASE_US + PROGRAM_US) + (length * READ_US_PER_KB) // 1024
+
+if len(sys.argv) < 2:
+    print("usage: image_extent.py IMAGE.bin [SLOT_SIZE [MODE]]")
+    sys.exit(1)
+
+with open(sys.argv[1], "rb") as image_file:
+    image = image_file.read()
+slot_size = int(sys.argv[2], 0) if len(sys.argv) > 2 else SLOT_SIZE
+mode = sys.argv[3] if len(sys.argv) > 3 else "overwrite"
+
+try:
+    hashed, extent, tlvs = parse(image)
+except (ValueError, struct.error) as error:
+    print("image_extent: {}: {}".format(sys.argv[1], error))
+    sys.exit(1)
+
+failed = False
+if TLV_SHA256 not in tlvs:
+    print("image_extent: no SHA-256 TLV")
+    failed = True
+elif hashlib.sha256(image[:hashed]).digest() != tlvs[TLV_SHA256]:
+    print("image_extent: SHA-256 does not match the image")
+    failed = True
+
+padding = image[extent:]
+if padding and padding.count(ERASE_VALUE) != len(padding):
+    print("image_extent: {} bytes of data after the TLVs".format(len(padding)))
+    failed = True
+elif padding:
+    print("image_extent: padded by {} bytes; drop --pad from the sign command so the OTA "
+          "agent and MCUboot only handle the populated region".format(len(padding)))
+    failed = True
+
+spare = TRAILER_SECTORS + (1 if mode == "swap_move" else 0)
+if sectors(extent) + spare > slot_size // SECTOR_SIZE:
+    print("image_extent: {} bytes do not fit the slot of {} bytes with {} sectors kept free".format(
+        extent, slot_size, spare))
+    failed = True
+
+# Validation hashes the header, the image and the protected TLVs. A copy of
+# the whole slot erases and programs every row of it; a copy of the populated
+# region stops at the sector that holds the last TLV.
+validate_us = (hashed * HASH_US_PER_KB) // 1024
+full_us = copy_us(slot_size) + validate_us
+populated_us = copy_us(extent) + validate_us
+print("Image: header + image {} bytes, TLVs {} bytes, populated {} bytes ({} sectors) of a {} byte slot".format(
+    hashed, extent - hashed, extent, sectors(extent), slot_size))
+print("Boot with an update: {:.1f} s copying the slot, {:.1f} s copying the populated region, "
+      "{:.1f} s saved".format(full_us / 1e6, populated_us / 1e6, (full_us - populated_us) / 1e6))
+
+sys.exit(1 if failed else 0)
@@ -0,0 +1,87 @@
+import random
+import statistics
+
+# Simulates the FreeRTOS scheduler of the device during a download, to pick
+# a download throttle that keeps the application tasks on time. A periodic
+# probe task like the one of source/jitter_probe.c runs next to the network
+# and OTA work of every chunk; the wake-up lateness of the probe is reported
+# for each throughput in THROUGHPUTS_KBPS.
+#
+# Measure the costs below on the device: the CPU share of the tcpip and OTA
+# threads per KB/s from scripts/rtos_stats_viewer.py, and the stall of a flash
+# row write from the flash erase/download rows of the jitter report
+# (JITTER_BENCHMARK=1). Compare the "unthrottled" line with that report to
+# check the model before trusting the other lines.
+TICK_US = 1000                  # configTICK_RATE_HZ of 1000
+STEP_US = 10                    # Simulation resolution
+DURATION_S = 20
+
+PROBE_PERIOD_US = 10000         # JITTER_PROBE_PERIOD_MS
+PROBE_COST_US = 20
+PROBE_PRIORITY = 4              # configMAX_PRIORITIES - 3
+
+NET_PRIORITY = 6                # tcpip thread and Wi-Fi driver
+NET_US_PER_KB = 180             # Receive and TLS decrypt cost per KB
+OTA_PRIORITY = 4                # OTA agent thread, same as the application tasks
+OTA_US_PER_CHUNK = 400          # Chunk handling besides the flash write
+CHUNK_SIZE = 4096
+FLASH_ROW_SIZE = 512
+FLASH_ROW_STALL_US = 0          # Time a row write holds off every task
+
+THROUGHPUTS_KBPS = [8, 16, 32, 64, 128, None]   # None: as fast as the link allows
+LINK_KBPS = 200
+
+def simulate(throughput_kbps):
+    rate = (throughput_kbps or LINK_KBPS) * 1024
+    chunk_interval_us = CHUNK_SIZE * 1000000 // rate
+    rows = CHUNK_SIZE // FLASH_ROW_SIZE
+
+    # Ready jobs as [priority, release order, remaining us, name, released at]
+    ready = []
+    order = 0
+    stall_until = 0
+    next_probe = PROBE_PERIOD_US
+    next_chunk = random.randint(0, chunk_interval_us)
+    lateness = []
+    running = None
+
+    for now in range(0, DURATION_S * 1000000, STEP_US):
+        if now >= next_probe:
+            ready.append([PROBE_PRIORITY, order, PROBE_COST_US, "probe", next_probe])
+            order += 1
+            next_probe += PROBE_PERIOD_US
+        if now >= next_chunk:
+            ready.append([NET_PRIORITY, order, NET_US_PER_KB * CHUNK_SIZE // 1024, "net", now])
+            ready.append([OTA_PRIORITY, order + 1, OTA_US_PER_CHUNK, "ota", now])
+            order += 2
+            next_chunk += int(chunk_interval_us * random.uniform(0.8, 1.2))
+
+        if now < stall_until or not ready:
+            continue
+
+        # Highest priority first; equal priorities share the CPU at every tick
+        top = max(job[0] for job in ready)
+        candidates = [job for job in ready if job[0] == top]
+        if running not in candidates or now % TICK_US == 0:
+            if running in candidates and len(candidates) > 1:
+                running[1] = order
+                order += 1
+            running = min(candidates, key=lambda job: job[1])
+
+        if running[3] == "probe" and running[2] == PROBE_COST_US:
+            lateness.append(now - running[4])
+        running[2] -= STEP_US
+        if running[2] <= 0:
+            ready.remove(running)
+            if running[3] == "ota":
+                stall_until = now + rows * FLASH_ROW_STALL_US
+            running = None
+
+    return lateness
+
+print("{:>12} {:>8} {:>8} {:>8}".format("THROUGHPUT", "P50 us", "P99 us", "MAX us"))
+for throughput in THROUGHPUTS_KBPS:
+    samples = sorted(simulate(throughput))
+    print("{:>12} {:>8} {:>8} {:>8}".format(
+          "unthrottled" if throughput is None else "{} KB/s".format(throughput),
+          int(statistics.median(samples)), samples[int(len(samples) * 0.99)], samples[-1]))
@@ -4,6 +4,9 @@ import struct
 import traceback
 import time
 
+from ota_package import open_package
+from mqtt_stream import MqttStream
+
 KIT = "CY8CPROTO-062-4343W"
 BROKER_ADDRESS = "test.mosquitto.org"
 TLS_ENABLED = False
@@ -15,14 +18,23 @@ PUBLISH_QOS = 1     # AWS broker does not support QOS of 2
 # Can take "Multiple" and "Single" as values. 
 # Single - Publish a single message to a broker, then disconnect cleanly. That is, the script will disconnect and reconnect for publishing every chunk.
 # Multiple - Publish multiple messages to a broker, then disconnect cleanly. That is, the script will publish all messages at once and then disconnect.
+# ZeroCopy - Like Multiple, but the payloads of OTA_PACKAGE_FILE go from the memory map straight to the socket, to every topic of ZERO_COPY_TOPICS.
 PUBLISH_TYPE = "Multiple"
 
+# Topics of the ZeroCopy mode, one per device stream; the chunks go to them in turn
+ZERO_COPY_TOPICS = [PUBLISH_TOPIC]
+
 # Full file path to the firmware image
 FW_IMAGE_FILE = "../build/" + KIT + "/Debug/mtb-example-anycloud-ota-mqtt.bin"
 
+# Package of the image made by the build (scripts/ota_package.py). When it
+# exists, its payloads are published as they are instead of chunking
+# FW_IMAGE_FILE, and the version is the one of the build.
+OTA_PACKAGE_FILE = "../build/" + KIT + "/Debug/mtb-example-anycloud-ota-mqtt.otapkg"
+
 # Paho MQTT client settings
 MQTT_KEEP_ALIVE = 60 # in seconds
-CHUNK_SIZE = (4 * 1024)
+CHUNK_SIZE = (4 * 1024)  # CY_OTA_CHUNK_SIZE of configs/cy_ota_config.h
 
 # OTA header information
 HEADER_SIZE = 32 # in bytes
@@ -87,6 +99,39 @@ def do_chunking(image_file):
 
         return mqtt_msgs
 
+def read_package(package_file):
+    package, manifest, chunks = open_package(package_file)
+    print("Package of image " + manifest["image"] + " version " + manifest["app_version"] +
+          ", Image Size: " + str(manifest["image_size"]) + ", Total Payloads: " + str(len(chunks)))
+
+    mqtt_msgs = []
+    for offset, size in chunks:
+        packet = package[offset:offset + size]
+        if PUBLISH_TYPE == "Single":
+            mqtt_msgs.append(packet)
+        else:
+            mqtt_msgs.append({'topic':PUBLISH_TOPIC, 'payload':packet, 'qos':PUBLISH_QOS})
+    package.close()
+    return mqtt_msgs
+
+def publish_zero_copy(package_file):
+    package, manifest, chunks = open_package(package_file)
+    print("Package of image " + manifest["image"] + " version " + manifest["app_version"] +
+          ", Total Payloads: " + str(len(chunks)) + ", Streams: " + str(len(ZERO_COPY_TOPICS)))
+
+    view = memoryview(package)
+    stream = MqttStream(BROKER_ADDRESS, BROKER_PORT, MQTT_CLIENT_ID, MQTT_KEEP_ALIVE, tls_dict)
+    start = time.time()
+    for offset, size in chunks:
+        for topic in ZERO_COPY_TOPICS:
+            stream.publish(topic, view[offset:offset + size], PUBLISH_QOS)
+    stream.disconnect()
+    elapsed = max(time.time() - start, 1e-6)
+    print("Published %d bytes in %.2f s, %.1f KB/s" % (stream.bytes_sent, elapsed, stream.bytes_sent / 1024 / elapsed))
+
+    view.release()
+    package.close()
+
 tls_dict = None
 if TLS_ENABLED:
     tls_dict = {'ca_certs':"mosquitto.org.crt", 'certfile':"client.crt", 'keyfile':"client.key"}
@@ -95,16 +140,23 @@ else:
     print("Unencrypted connection to \"" + BROKER_ADDRESS + ":" + str(BROKER_PORT) + "\"" + os.linesep)
 
 try:
-    mqtt_msgs = do_chunking(FW_IMAGE_FILE)
-    chunk_count = 0
-    print("Publishing Begins...")
-    if PUBLISH_TYPE == "Single":
-        for msg in mqtt_msgs:
-            publish.single(PUBLISH_TOPIC, msg, PUBLISH_QOS, hostname=BROKER_ADDRESS, port=BROKER_PORT, client_id=MQTT_CLIENT_ID, keepalive=MQTT_KEEP_ALIVE, tls=tls_dict)
-            chunk_count = chunk_count + 1
-            print("Published Chunk %d" %(chunk_count))
+    if PUBLISH_TYPE == "ZeroCopy":
+        print("Publishing Begins...")
+        publish_zero_copy(OTA_PACKAGE_FILE)
     else:
-        publish.multiple(mqtt_msgs, hostname=BROKER_ADDRESS, port=BROKER_PORT, client_id=MQTT_CLIENT_ID, keepalive=MQTT_KEEP_ALIVE, tls=tls_dict)
+        if os.path.exists(OTA_PACKAGE_FILE):
+            mqtt_msgs = read_package(OTA_PACKAGE_FILE)
+        else:
+            mqtt_msgs = do_chunking(FW_IMAGE_FILE)
+        chunk_count = 0
+        print("Publishing Begins...")
+        if PUBLISH_TYPE == "Single":
+            for msg in mqtt_msgs:
+                publish.single(PUBLISH_TOPIC, msg, PUBLISH_QOS, hostname=BROKER_ADDRESS, port=BROKER_PORT, client_id=MQTT_CLIENT_ID, keepalive=MQTT_KEEP_ALIVE, tls=tls_dict)
+                chunk_count = chunk_count + 1
+                print("Published Chunk %d" %(chunk_count))
+        else:
+            publish.multiple(mqtt_msgs, hostname=BROKER_ADDRESS, port=BROKER_PORT, client_id=MQTT_CLIENT_ID, keepalive=MQTT_KEEP_ALIVE, tls=tls_dict)
     print("Publishing Ends...")
 except Exception as e:
     print("Exception Occurred... Exiting...")
@@ -0,0 +1,122 @@
+import socket
+import ssl
+import struct
+
+# Minimal MQTT 3.1.1 publisher that writes payloads to the socket without
+# copying them. paho takes a payload only as bytes and copies it into every
+# packet; here the fixed and variable headers are built per message and the
+# payload, e.g. a memoryview slice of a mapped .otapkg package, is handed to
+# the socket as it is (scatter/gather with sendmsg where the socket has it).
+# QoS 0 and 1 only; PUBACKs are collected while up to WINDOW messages are in
+# flight.
+CONNECT = 0x10
+CONNACK = 0x20
+PUBLISH = 0x30
+PUBACK = 0x40
+DISCONNECT = 0xE0
+
+WINDOW = 16
+
+def remaining_length(length):
+    encoded = bytearray()
+    while True:
+        digit = length % 128
+        length //= 128
+        encoded.append(digit | (0x80 if length > 0 else 0))
+        if length == 0:
+            return bytes(encoded)
+
+def utf8_field(text):
+    data = text.encode("utf-8")
+    return struct.pack(">H", len(data)) + data
+
+def connect_packet(client_id, keepalive):
+    body = utf8_field("MQTT") + bytes([4, 0x02]) + struct.pack(">H", keepalive) + utf8_field(client_id)
+    return bytes([CONNECT]) + remaining_length(len(body)) + body
+
+def publish_header(topic, payload_size, qos, packet_id):
+    variable = utf8_field(topic) + (struct.pack(">H", packet_id) if qos > 0 else b"")
+    return bytes([PUBLISH | (qos << 1)]) + remaining_length(len(variable) + payload_size) + variable
+
+def parse_packet(buffer):
+    # Returns (type, body, bytes used), or None if the packet is incomplete
+    length = 0
+    for position in range(1, min(len(buffer), 5)):
+        length += (buffer[position] & 0x7F) << (7 * (position - 1))
+        if not buffer[position] & 0x80:
+            end = position + 1 + length
+            if len(buffer) < end:
+                return None
+            return buffer[0] & 0xF0, bytes(buffer[position + 1:end]), end
+    return None
+
+class MqttStream:
+    def __init__(self, host, port, client_id, keepalive=60, tls=None, window=WINDOW):
+        sock = socket.create_connection((host, port))
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        if tls is not None:
+            context = ssl.create_default_context(cafile=tls.get("ca_certs"))
+            if tls.get("certfile"):
+                context.load_cert_chain(tls["certfile"], tls.get("keyfile"))
+            sock = context.wrap_socket(sock, server_hostname=host)
+        self.sock = sock
+        self.scatter = hasattr(sock, "sendmsg") and not isinstance(sock, ssl.SSLSocket)
+        self.window = window
+        self.inflight = set()
+        self.next_id = 1
+        self.received = bytearray()
+        self.bytes_sent = 0
+
+        self.sock.sendall(connect_packet(client_id, keepalive))
+        packet_type, body = self.read_packet()
+        if packet_type != CONNACK or len(body) < 2 or body[1] != 0:
+            raise ConnectionError("broker refused the connection")
+
+    def read_packet(self):
+        while True:
+            packet = parse_packet(self.received)
+            if packet is not None:
+                del self.received[:packet[2]]
+                return packet[0], packet[1]
+            data = self.sock.recv(4096)
+            if not data:
+                raise ConnectionError("broker closed the connection")
+            self.received += data
+
+    def wait_acks(self, limit):
+        while len(self.inflight) > limit:
+            packet_type, body = self.read_packet()
+            if packet_type == PUBACK:
+                self.inflight.discard(struct.unpack(">H", body[:2])[0])
+
+    def send(self, header, payload):
+        if self.scatter:
+            pending = [memoryview(header), memoryview(payload)]
+            while pending:
+                sent = self.sock.sendmsg(pending)
+                while pending and sent >= len(pending[0]):
+                    sent -= len(pending[0])
+                    pending.pop(0)
+                if pending:
+                    pending[0] = pending[0][sent:]
+        else:
+            self.sock.sendall(header)
+            self.sock.sendall(payload)
+        self.bytes_sent += len(header) + len(payload)
+
+    def publish(self, topic, payload, qos=1):
+        packet_id = 0
+        if qos > 0:
+            self.wait_acks(self.window - 1)
+            packet_id = self.next_id
+            self.next_id = (self.next_id % 0xFFFF) + 1
+            self.inflight.add(packet_id)
+        self.send(publish_header(topic, len(payload), qos, packet_id), payload)
+
+    def flush(self):
+        self.wait_acks(0)
+
+    def disconnect(self):
+        self.flush()
+        self.sock.sendall(bytes([DISCONNECT, 0]))
+        self.sock.close()
@@ -0,0 +1,120 @@
+import json
+import sys
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+from ota_package import open_package
+from mqtt_stream import MqttStream
+
+# Carousel mode for fleet-wide updates on one site:
+#   python ota_carousel_publisher.py DEVICES.txt [PACKAGE.otapkg]
+# The chunks of the package are published in a loop on one topic shared by
+# all devices, until every device listed in DEVICES.txt (one device id per
+# line, the OTA_MQTT_ID of each device, or the first column of the CSV of
+# ota_fleet_publisher.py) reports that the OTA agent has verified the image.
+# Devices built with ENABLE_OTA_CAROUSEL join the cycle at any point, take
+# each chunk until the agent has written it and drop the repeats; the broker sends each cycle to all of them, so
+# the egress of the publisher grows with the image size and the number of
+# cycles, not with the number of devices.
+KIT = "CY8CPROTO-062-4343W"
+BROKER_ADDRESS = "test.mosquitto.org"
+TLS_ENABLED = False
+BROKER_PORT = 1883  # For Mosquitto: Port = 8884 when TLS is enabled; Port = 1883 otherwise
+MQTT_CLIENT_ID = "OTACarouselPublisher"
+MQTT_KEEP_ALIVE = 60 # in seconds
+CAROUSEL_TOPIC = "anycloud/test/ota/image"
+STATUS_TOPIC = "anycloud/test/ota/status"   # CAROUSEL_STATUS_TOPIC of the devices
+PUBLISH_QOS = 1
+
+OTA_PACKAGE_FILE = "../build/" + KIT + "/Debug/mtb-example-anycloud-ota-mqtt.otapkg"
+
+# Rate of the cycle; the slowest device should keep up with most chunks
+CAROUSEL_KBPS = 32
+MAX_CYCLES = 50
+
+class FleetStatus:
+    def __init__(self, devices, version):
+        self.lock = threading.Lock()
+        self.version = version
+        self.held = {device: (0, 0, False) for device in devices}
+        self.unknown = set()
+
+    def on_message(self, client, userdata, message):
+        try:
+            status = json.loads(message.payload.decode("utf-8"))
+            device = status["id"]
+            report = (int(status["held"]), int(status["total"]), status.get("complete") is True)
+        except (ValueError, KeyError, UnicodeDecodeError):
+            return
+        with self.lock:
+            if device not in self.held:
+                self.unknown.add(device)
+            elif status.get("version") == self.version:
+                self.held[device] = report
+
+    def complete(self):
+        with self.lock:
+            return [device for device, (_, _, complete) in self.held.items() if complete]
+
+    def joined(self):
+        with self.lock:
+            return [device for device, (_, total, _) in self.held.items() if total > 0]
+
+def read_devices(path):
+    with open(path) as device_file:
+        return [line.split(",")[0].strip() for line in device_file
+                if line.strip() and not line.startswith("#")]
+
+if len(sys.argv) < 2:
+    print("usage: ota_carousel_publisher.py DEVICES.txt [PACKAGE.otapkg]")
+    sys.exit(1)
+
+devices = read_devices(sys.argv[1])
+package, manifest, chunks = open_package(sys.argv[2] if len(sys.argv) > 2 else OTA_PACKAGE_FILE)
+view = memoryview(package)
+cycle_bytes = sum(size for _, size in chunks)
+print("Package of image " + manifest["image"] + " version " + manifest["app_version"] +
+      ", Total Payloads: " + str(len(chunks)) + ", Devices: " + str(len(devices)))
+
+tls_dict = None
+if TLS_ENABLED:
+    tls_dict = {'ca_certs':"mosquitto.org.crt", 'certfile':"client.crt", 'keyfile':"client.key"}
+
+fleet = FleetStatus(devices, manifest["app_version"])
+status_client = mqtt.Client(MQTT_CLIENT_ID + "-status")
+if tls_dict is not None:
+    status_client.tls_set(**tls_dict)
+status_client.on_message = fleet.on_message
+status_client.connect(BROKER_ADDRESS, BROKER_PORT, MQTT_KEEP_ALIVE)
+status_client.subscribe(STATUS_TOPIC, 1)
+status_client.loop_start()
+
+stream = MqttStream(BROKER_ADDRESS, BROKER_PORT, MQTT_CLIENT_ID, MQTT_KEEP_ALIVE, tls_dict)
+start = time.time()
+cycle = 0
+while len(fleet.complete()) < len(devices) and cycle < MAX_CYCLES:
+    cycle += 1
+    for offset, size in chunks:
+        stream.publish(CAROUSEL_TOPIC, view[offset:offset + size], PUBLISH_QOS)
+        ahead = start + stream.bytes_sent / 1024 / CAROUSEL_KBPS - time.time()
+        if ahead > 0:
+            time.sleep(ahead)
+        if len(fleet.complete()) == len(devices):
+            break
+    print("Cycle %d: %d of %d devices joined, %d complete, %.1f MB sent, %.1f times the image" % (
+        cycle, len(fleet.joined()), len(devices), len(fleet.complete()),
+        stream.bytes_sent / 1024 / 1024, stream.bytes_sent / cycle_bytes))
+
+stream.disconnect()
+status_client.loop_stop()
+status_client.disconnect()
+
+missing = sorted(set(devices) - set(fleet.complete()))
+if fleet.unknown:
+    print("Status from devices not in the list: " + ", ".join(sorted(fleet.unknown)))
+if missing:
+    print("Not complete after %d cycles: %s" % (cycle, ", ".join(missing)))
+    sys.exit(1)
+print("All %d devices hold the image after %d cycles, %.1f s" % (len(devices), cycle, time.time() - start))
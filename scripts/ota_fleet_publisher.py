@@ -0,0 +1,214 @@
+import asyncio
+import csv
+import ssl
+import struct
+import sys
+import time
+
+from ota_package import open_package
+from mqtt_stream import connect_packet, parse_packet, publish_header, CONNACK, PUBACK, DISCONNECT
+
+# Publishes one .otapkg package to many devices at once, for a rollout wave:
+#   python ota_fleet_publisher.py DEVICES.csv [PACKAGE.otapkg]
+# DEVICES.csv has one "device id,topic" line per device; lines starting with
+# '#' are skipped. Every device must subscribe to its own topic (my_topics in
+# source/ota_app_config.h). The OTA sessions share a pool of MQTT connections;
+# each session has its own window of QoS 1 messages in flight, so one session
+# waiting on the broker does not hold up the others. The window only limits
+# the messages not yet acknowledged by the broker: the PUBACK comes from the
+# broker, not the device, so a device that takes the chunks slower than the
+# broker accepts them gets them queued at the broker, up to its queue limit
+# (max_queued_messages in mosquitto). The throughput and the "done" status are
+# those of the broker accepting the chunks, not of the device storing them.
+# The aggregate throughput is printed every PROGRESS_PERIOD_S and the
+# per-device results are written to REPORT_FILE.
+KIT = "CY8CPROTO-062-4343W"
+BROKER_ADDRESS = "test.mosquitto.org"
+TLS_ENABLED = False
+BROKER_PORT = 1883  # For Mosquitto: Port = 8884 when TLS is enabled; Port = 1883 otherwise
+MQTT_CLIENT_ID = "OTAFleetPublisher"
+MQTT_KEEP_ALIVE = 60 # in seconds
+PUBLISH_QOS = 1
+
+OTA_PACKAGE_FILE = "../build/" + KIT + "/Debug/mtb-example-anycloud-ota-mqtt.otapkg"
+REPORT_FILE = "fleet_report.csv"
+
+CONNECTIONS = 8             # MQTT connections to the broker
+MAX_SESSIONS = 256          # Devices updated at the same time; the others wait
+SESSION_WINDOW = 4          # Messages per device not yet acknowledged by the broker
+PROGRESS_PERIOD_S = 5
+
+class Connection:
+    def __init__(self, index):
+        self.client_id = MQTT_CLIENT_ID + "-" + str(index)
+        self.acks = {}
+        self.next_id = 1
+
+    async def open(self):
+        context = None
+        if TLS_ENABLED:
+            context = ssl.create_default_context(cafile="mosquitto.org.crt")
+            context.load_cert_chain("client.crt", "client.key")
+        self.reader, self.writer = await asyncio.open_connection(BROKER_ADDRESS, BROKER_PORT, ssl=context)
+        self.writer.write(connect_packet(self.client_id, MQTT_KEEP_ALIVE))
+        self.received = bytearray()
+        packet_type, body = await self.read_packet()
+        if packet_type != CONNACK or len(body) < 2 or body[1] != 0:
+            raise ConnectionError(self.client_id + ": broker refused the connection")
+        self.read_task = asyncio.ensure_future(self.read_loop())
+
+    async def read_packet(self):
+        while True:
+            packet = parse_packet(self.received)
+            if packet is not None:
+                del self.received[:packet[2]]
+                return packet[0], packet[1]
+            data = await self.reader.read(4096)
+            if not data:
+                raise ConnectionError(self.client_id + ": broker closed the connection")
+            self.received += data
+
+    async def read_loop(self):
+        try:
+            while True:
+                packet_type, body = await self.read_packet()
+                if packet_type == PUBACK:
+                    ack = self.acks.pop(struct.unpack(">H", body[:2])[0], None)
+                    if ack is not None and not ack.done():
+                        ack.set_result(None)
+        except (ConnectionError, asyncio.IncompleteReadError, OSError) as error:
+            for ack in self.acks.values():
+                if not ack.done():
+                    ack.set_exception(ConnectionError(str(error)))
+            self.acks.clear()
+
+    async def publish(self, topic, payload):
+        # Returns a future that completes with the PUBACK, or None for QoS 0
+        ack = None
+        packet_id = 0
+        if PUBLISH_QOS > 0:
+            while self.next_id in self.acks:
+                self.next_id = (self.next_id % 0xFFFF) + 1
+            packet_id = self.next_id
+            self.next_id = (self.next_id % 0xFFFF) + 1
+            ack = asyncio.get_event_loop().create_future()
+            self.acks[packet_id] = ack
+        self.writer.write(publish_header(topic, len(payload), PUBLISH_QOS, packet_id))
+        self.writer.write(payload)
+        await self.writer.drain()
+        return ack
+
+    async def close(self):
+        self.writer.write(bytes([DISCONNECT, 0]))
+        await self.writer.drain()
+        self.read_task.cancel()
+        self.writer.close()
+
+class Session:
+    def __init__(self, device, topic, connection):
+        self.device = device
+        self.topic = topic
+        self.connection = connection
+        self.bytes_acked = 0
+        self.start = None
+        self.end = None
+        self.error = None
+
+    def acked(self, size, ack, window):
+        window.release()
+        if not ack.cancelled() and ack.exception() is None:
+            self.bytes_acked += size
+
+    async def run(self, view, chunks):
+        window = asyncio.Semaphore(SESSION_WINDOW)
+        pending = []
+        self.start = time.monotonic()
+        try:
+            for offset, size in chunks:
+                await window.acquire()
+                ack = await self.connection.publish(self.topic, view[offset:offset + size])
+                if ack is None:
+                    window.release()
+                    self.bytes_acked += size
+                else:
+                    ack.add_done_callback(lambda done, size=size: self.acked(size, done, window))
+                    pending.append(ack)
+            await asyncio.gather(*pending)
+        except (ConnectionError, OSError) as error:
+            self.error = str(error)
+        self.end = time.monotonic()
+
+    def throughput(self):
+        if self.start is None:
+            return 0.0
+        elapsed = max((self.end or time.monotonic()) - self.start, 1e-6)
+        return self.bytes_acked / 1024 / elapsed
+
+def read_devices(path):
+    devices = []
+    with open(path, newline="") as device_file:
+        for row in csv.reader(device_file):
+            if row and not row[0].startswith("#"):
+                devices.append((row[0].strip(), row[1].strip()))
+    return devices
+
+async def report_progress(sessions, started):
+    last_bytes = 0
+    while True:
+        await asyncio.sleep(PROGRESS_PERIOD_S)
+        total = sum(session.bytes_acked for session in sessions)
+        done = sum(1 for session in sessions if session.end is not None and session.error is None)
+        failed = sum(1 for session in sessions if session.error is not None)
+        active = sum(1 for session in sessions if session.start is not None and session.end is None)
+        print("%6.0f s: %d active, %d done, %d failed, %.1f KB/s, %.1f MB sent" % (
+            time.monotonic() - started, active, done, failed,
+            (total - last_bytes) / 1024 / PROGRESS_PERIOD_S, total / 1024 / 1024))
+        last_bytes = total
+
+def write_report(sessions, path):
+    with open(path, "w", newline="") as report:
+        writer = csv.writer(report)
+        writer.writerow(["device", "topic", "bytes", "seconds", "KB/s", "status"])
+        for session in sessions:
+            seconds = (session.end - session.start) if session.end is not None else 0.0
+            writer.writerow([session.device, session.topic, session.bytes_acked, "%.2f" % seconds,
+                             "%.1f" % session.throughput(), session.error or "done"])
+
+async def main(devices, package_path):
+    package, manifest, chunks = open_package(package_path)
+    view = memoryview(package)
+    print("Package of image " + manifest["image"] + " version " + manifest["app_version"] +
+          ", Total Payloads: " + str(len(chunks)) + ", Devices: " + str(len(devices)))
+
+    connections = [Connection(index) for index in range(min(CONNECTIONS, len(devices)))]
+    await asyncio.gather(*(connection.open() for connection in connections))
+    sessions = [Session(device, topic, connections[index % len(connections)])
+                for index, (device, topic) in enumerate(devices)]
+
+    limit = asyncio.Semaphore(MAX_SESSIONS)
+
+    async def run_limited(session):
+        async with limit:
+            await session.run(view, chunks)
+
+    started = time.monotonic()
+    reporter = asyncio.ensure_future(report_progress(sessions, started))
+    await asyncio.gather(*(run_limited(session) for session in sessions))
+    reporter.cancel()
+    for connection in connections:
+        await connection.close()
+
+    elapsed = max(time.monotonic() - started, 1e-6)
+    total = sum(session.bytes_acked for session in sessions)
+    failed = [session for session in sessions if session.error is not None]
+    print("Sent %.1f MB to %d devices in %.1f s, %.1f KB/s aggregate, %d failed" % (
+        total / 1024 / 1024, len(sessions) - len(failed), elapsed, total / 1024 / elapsed, len(failed)))
+    write_report(sessions, REPORT_FILE)
+    print("Per-device throughput written to " + REPORT_FILE)
+
+if len(sys.argv) < 2:
+    print("usage: ota_fleet_publisher.py DEVICES.csv [PACKAGE.otapkg]")
+    sys.exit(1)
+
+asyncio.get_event_loop().run_until_complete(
+    main(read_devices(sys.argv[1]), sys.argv[2] if len(sys.argv) > 2 else OTA_PACKAGE_FILE))
@@ -0,0 +1,171 @@
+import hashlib
+import json
+import mmap
+import os
+import struct
+import sys
+import zlib
+
+# Builds the .otapkg package of a signed image, run by POSTBUILD:
+#   python ota_package.py IMAGE.bin PACKAGE.otapkg VERSION [--zlib] [--delta OLD.bin]
+# The package holds every MQTT payload of the update ready to publish, so the
+# publishers do no chunking and all of them send the same bytes. Layout:
+#
+#   char     magic[8]        "OTAPKG1\0"
+#   uint32_t manifest_size
+#   uint32_t reserved
+#   char     manifest[]      JSON, padded with spaces to 8 bytes
+#   chunks of every variant, one after the other, each:
+#     char     magic[4]      "OTAC"
+#     uint16_t variant       Index of the variant in the manifest
+#     uint16_t index         Payload index within the variant
+#     uint32_t size          Payload size
+#     uint32_t crc32         CRC-32 of the payload
+#     uint8_t  payload[size] Chunk header of cy_ota_mqtt.c + data
+#
+# The manifest lists the image, its SHA-256 and version, and the variants
+# with the offset of their first chunk. "full" is the image as the OTA agent
+# takes it. "zlib" is the compressed image and "delta" the chunks that differ
+# from an older image; the OTA agent of this example only takes "full".
+PACKAGE_MAGIC = b"OTAPKG1\0"
+PACKAGE_VERSION = 1
+CHUNK_MAGIC = b"OTAC"
+CHUNK_RECORD = struct.Struct("<4sHHII")
+PACKAGE_HEADER = struct.Struct("<8sII")
+
+# Payload header, as in scripts/mqtt_ota_publisher.py
+CHUNK_SIZE = (4 * 1024)  # CY_OTA_CHUNK_SIZE of configs/cy_ota_config.h
+HEADER_SIZE = 32
+HEADER_MAGIC = "OTAImage"
+IMAGE_TYPE = 0
+
+def payload_header(version, total_size, offset, data_size, total_payloads, index):
+    header = bytearray(HEADER_SIZE)
+    struct.pack_into('<8s5H2I3H', header, 0, HEADER_MAGIC.encode('ascii'),
+                     HEADER_SIZE, IMAGE_TYPE, version[0], version[1], version[2],
+                     total_size, offset, data_size, total_payloads, index)
+    return header
+
+def chunk_payloads(data, version, offsets=None):
+    # offsets: image offsets to include, all of them by default
+    if offsets is None:
+        offsets = range(0, len(data), CHUNK_SIZE)
+    offsets = list(offsets)
+    payloads = []
+    for index, offset in enumerate(offsets):
+        chunk = data[offset:offset + CHUNK_SIZE]
+        payloads.append(bytes(payload_header(version, len(data), offset, len(chunk), len(offsets), index)) + chunk)
+    return payloads
+
+def build(image_path, package_path, version, compress=False, old_path=None):
+    with open(image_path, "rb") as image_file:
+        image = image_file.read()
+
+    variants = [("full", image, chunk_payloads(image, version))]
+    if compress:
+        packed = zlib.compress(image, 9)
+        variants.append(("zlib", packed, chunk_payloads(packed, version)))
+    if old_path is not None:
+        with open(old_path, "rb") as old_file:
+            old = old_file.read()
+        changed = [offset for offset in range(0, len(image), CHUNK_SIZE)
+                   if image[offset:offset + CHUNK_SIZE] != old[offset:offset + CHUNK_SIZE]]
+        variants.append(("delta", image, chunk_payloads(image, version, changed)))
+
+    manifest = {
+        "version": PACKAGE_VERSION,
+        "image": os.path.basename(image_path),
+        "image_size": len(image),
+        "sha256": hashlib.sha256(image).hexdigest(),
+        "app_version": "{}.{}.{}".format(*version),
+        "chunk_size": CHUNK_SIZE,
+        "header_size": HEADER_SIZE,
+        "variants": [],
+    }
+
+    # The offsets in the manifest depend on its own size; lay it out until
+    # the size settles
+    manifest_bytes = b""
+    while True:
+        offset = PACKAGE_HEADER.size + len(manifest_bytes)
+        manifest["variants"] = []
+        for name, data, payloads in variants:
+            size = sum(CHUNK_RECORD.size + len(payload) for payload in payloads)
+            manifest["variants"].append({
+                "name": name,
+                "data_size": len(data),
+                "sha256": hashlib.sha256(data).hexdigest(),
+                "chunks": len(payloads),
+                "offset": offset,
+                "size": size,
+            })
+            offset += size
+        laid_out = json.dumps(manifest, sort_keys=True).encode("utf-8")
+        laid_out += b" " * (-len(laid_out) % 8)
+        if len(laid_out) == len(manifest_bytes):
+            manifest_bytes = laid_out
+            break
+        manifest_bytes = laid_out
+
+    with open(package_path + ".tmp", "wb") as package:
+        package.write(PACKAGE_HEADER.pack(PACKAGE_MAGIC, len(manifest_bytes), 0))
+        package.write(manifest_bytes)
+        for variant, (_, _, payloads) in enumerate(variants):
+            if package.tell() != manifest["variants"][variant]["offset"]:
+                raise RuntimeError("package layout mismatch")
+            for index, payload in enumerate(payloads):
+                package.write(CHUNK_RECORD.pack(CHUNK_MAGIC, variant, index, len(payload),
+                                                zlib.crc32(payload) & 0xFFFFFFFF))
+                package.write(payload)
+    os.replace(package_path + ".tmp", package_path)
+    return manifest
+
+def open_package(package_path, variant_name="full", verify=True):
+    # Returns the mapped package, its manifest and the (offset, size) of every
+    # payload of a variant; the payloads are slices of the map
+    with open(package_path, "rb") as package:
+        mapped = mmap.mmap(package.fileno(), 0, access=mmap.ACCESS_READ)
+    magic, manifest_size, _ = PACKAGE_HEADER.unpack_from(mapped, 0)
+    if magic != PACKAGE_MAGIC:
+        raise ValueError(package_path + " is not an OTA package")
+    manifest = json.loads(bytes(mapped[PACKAGE_HEADER.size:PACKAGE_HEADER.size + manifest_size]))
+
+    for variant, entry in enumerate(manifest["variants"]):
+        if entry["name"] == variant_name:
+            break
+    else:
+        raise ValueError("no {} variant in {}".format(variant_name, package_path))
+
+    chunks = []
+    offset = entry["offset"]
+    view = memoryview(mapped)
+    for index in range(entry["chunks"]):
+        magic, record_variant, record_index, size, crc = CHUNK_RECORD.unpack_from(mapped, offset)
+        offset += CHUNK_RECORD.size
+        if (magic != CHUNK_MAGIC) or (record_variant != variant) or (record_index != index):
+            raise ValueError("bad chunk record {} of {}".format(index, variant_name))
+        if verify and (zlib.crc32(view[offset:offset + size]) & 0xFFFFFFFF) != crc:
+            raise ValueError("CRC mismatch in chunk {} of {}".format(index, variant_name))
+        chunks.append((offset, size))
+        offset += size
+    view.release()
+    return mapped, manifest, chunks
+
+if __name__ == "__main__":
+    args = sys.argv[1:]
+    compress = "--zlib" in args
+    old_path = None
+    if "--delta" in args:
+        position = args.index("--delta")
+        old_path = args[position + 1] if position + 1 < len(args) else None
+        del args[position:position + 2]
+    args = [arg for arg in args if arg != "--zlib"]
+    if len(args) != 3 or ("--delta" in sys.argv and old_path is None):
+        print("usage: ota_package.py IMAGE.bin PACKAGE.otapkg VERSION [--zlib] [--delta OLD.bin]")
+        sys.exit(1)
+
+    version = [int(part) for part in args[2].split(".")]
+    manifest = build(args[0], args[1], version, compress, old_path)
+    for entry in manifest["variants"]:
+        print("{}: {} variant, {} payloads, {} bytes".format(
+            os.path.basename(args[1]), entry["name"], entry["chunks"], entry["size"]))
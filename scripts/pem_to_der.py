@@ -0,0 +1,102 @@
+import base64
+import os
+import re
+import sys
+
+# Converts the PEM credentials of ota_app_config.h to DER and writes them as
+# const arrays, so that mbedTLS parses them from flash without a base64 pass.
+# Run by the Makefile before every build:
+#   python pem_to_der.py <ota_app_config.h> <output header>
+# A credential that is empty, encrypted, or (for the root CA) holds more than
+# one certificate is left out; the application then uses the PEM string.
+
+# Macro in ota_app_config.h, name of the generated array and macros
+CREDENTIALS = [
+    ("ROOT_CA_CERTIFICATE", "ota_root_ca_der", "OTA_ROOT_CA"),
+    ("CLIENT_CERTIFICATE", "ota_client_cert_der", "OTA_CLIENT_CERT"),
+    ("CLIENT_KEY", "ota_client_key_der", "OTA_CLIENT_KEY"),
+]
+
+PEM_BLOCK = re.compile(r"-----BEGIN ([A-Z0-9 ]+)-----(.*?)-----END [A-Z0-9 ]+-+", re.DOTALL)
+C_STRING = re.compile(r'"((?:[^"\\]|\\.)*)"')
+C_ESCAPES = {"n": "\n", "r": "\r", "t": "\t", "\\": "\\", "\"": "\"", "'": "'"}
+
+BYTES_PER_LINE = 16
+
+def read_macros(config_file):
+    with open(config_file, "r") as config:
+        text = config.read()
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.DOTALL)
+    text = re.sub(r"//[^\n]*", "", text)
+    text = text.replace("\\\n", " ")
+    macros = {}
+    for line in text.splitlines():
+        match = re.match(r"\s*#\s*define\s+(\w+)\s+(.*)", line)
+        if match:
+            macros[match.group(1)] = match.group(2)
+    return macros
+
+def c_string_value(definition):
+    value = ""
+    for literal in C_STRING.findall(definition):
+        value += re.sub(r"\\(.)", lambda m: C_ESCAPES.get(m.group(1), m.group(1)), literal)
+    return value
+
+def pem_to_der(name, pem):
+    blocks = PEM_BLOCK.findall(pem)
+    if not blocks:
+        return None
+    if len(blocks) > 1:
+        print("pem_to_der: " + name + " holds " + str(len(blocks)) + " PEM blocks; keeping PEM")
+        return None
+    label, body = blocks[0]
+    if "ENCRYPTED" in label or "Proc-Type:" in body:
+        print("pem_to_der: " + name + " is encrypted; keeping PEM")
+        return None
+    return base64.b64decode("".join(body.split()))
+
+def c_array(array, der):
+    lines = []
+    for i in range(0, len(der), BYTES_PER_LINE):
+        lines.append("    " + ", ".join("0x{:02x}".format(b) for b in der[i:i + BYTES_PER_LINE]) + ",")
+    return "static const uint8_t " + array + "[] =\n{\n" + "\n".join(lines) + "\n};\n"
+
+def generate(config_file):
+    macros = read_macros(config_file)
+    out = []
+    out.append("/* Generated by scripts/pem_to_der.py from " + os.path.basename(config_file) + ". Do not edit. */")
+    out.append("#ifndef OTA_CREDENTIALS_DER_H_")
+    out.append("#define OTA_CREDENTIALS_DER_H_")
+    out.append("")
+    out.append("#include <stdint.h>")
+    out.append("")
+    for macro, array, name in CREDENTIALS:
+        der = pem_to_der(macro, c_string_value(macros.get(macro, "")))
+        if der is None:
+            out.append("/* " + macro + ": not converted */")
+            out.append("")
+            continue
+        out.append("/* " + macro + " */")
+        out.append(c_array(array, der))
+        out.append("#define " + name + " ((const char *)" + array + ")")
+        out.append("#define " + name + "_LEN (sizeof(" + array + "))")
+        out.append("")
+    out.append("#endif /* OTA_CREDENTIALS_DER_H_ */")
+    return "\n".join(out) + "\n"
+
+if len(sys.argv) != 3:
+    print("Usage: pem_to_der.py <ota_app_config.h> <output header>")
+    sys.exit(1)
+
+header = generate(sys.argv[1])
+
+# Leave the header untouched when nothing changed, so it does not trigger a rebuild
+output_file = sys.argv[2]
+if os.path.exists(output_file):
+    with open(output_file, "r") as existing:
+        if existing.read() == header:
+            sys.exit(0)
+
+os.makedirs(os.path.dirname(os.path.abspath(output_file)), exist_ok=True)
+with open(output_file, "w") as output:
+    output.write(header)
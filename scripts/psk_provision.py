@@ -0,0 +1,22 @@
+import binascii
+import hashlib
+import hmac
+import sys
+
+# Computes the pre-shared key of a device for the broker, the same way the
+# device derives it: HMAC-SHA256(fleet key, identity). The identity is printed
+# by the device at startup ("TLS PSK identity: ..."). Prints a line for the
+# mosquitto psk_file:
+#   python psk_provision.py <fleet key hex> <identity> >> psk_file.txt
+# and enable it in mosquitto.conf with "psk_hint" and "psk_file" on the
+# listener.
+
+if len(sys.argv) != 3:
+    print("Usage: psk_provision.py <fleet key hex> <identity>")
+    sys.exit(1)
+
+fleet_key = binascii.unhexlify(sys.argv[1])
+identity = sys.argv[2]
+
+device_key = hmac.new(fleet_key, identity.encode("ascii"), hashlib.sha256).hexdigest()
+print(identity + ":" + device_key)
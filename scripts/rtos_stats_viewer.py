@@ -0,0 +1,98 @@
+import csv
+import struct
+import sys
+import time
+
+import paho.mqtt.client as mqtt
+
+# Subscribes to the run-time statistics telemetry of a device and prints the
+# CPU share of every task. On Ctrl+C, the samples are saved to a CSV file and,
+# if matplotlib is installed, plotted as CPU share per task over time.
+BROKER_ADDRESS = "test.mosquitto.org"
+BROKER_PORT = 1883
+MQTT_CLIENT_ID = "RtosStatsViewer"
+TELEMETRY_TOPIC = "anycloud/test/ota/telemetry/CY_IOT_DEVICE"  # TELEMETRY_TOPIC in ota_app_config.h
+CSV_FILE = "rtos_stats.csv"
+
+MSG_MAGIC = b"RTS"
+MSG_VERSION = 1
+
+# Samples as (uptime in s, {task name: CPU share in %})
+samples = []
+
+def decode(payload):
+    magic, version, uptime_ms, period_us, task_count = struct.unpack_from("<3sBIIB", payload, 0)
+    if magic != MSG_MAGIC or version != MSG_VERSION:
+        return None
+    offset = struct.calcsize("<3sBIIB")
+    tasks = []
+    for _ in range(task_count):
+        number, priority, permille, stack_free, name_len = struct.unpack_from("<BBHHB", payload, offset)
+        offset += struct.calcsize("<BBHHB")
+        name = payload[offset:offset + name_len].decode("ascii", errors="replace")
+        offset += name_len
+        tasks.append((name, number, priority, permille / 10.0, stack_free))
+    return uptime_ms / 1000.0, period_us, tasks
+
+def on_connect(client, userdata, flags, rc):
+    print("Connected to " + BROKER_ADDRESS + ", waiting for telemetry on " + TELEMETRY_TOPIC)
+    client.subscribe(TELEMETRY_TOPIC)
+
+def on_message(client, userdata, msg):
+    sample = decode(msg.payload)
+    if sample is None:
+        print("Ignoring a message of unknown format")
+        return
+    uptime, period_us, tasks = sample
+    tasks.sort(key=lambda task: -task[3])
+    print("\n{:10.1f} s, period {} ms".format(uptime, period_us // 1000))
+    for name, number, priority, cpu, stack_free in tasks:
+        print("  {:<16} #{:<3} prio {:<2} {:6.1f} %   stack free {} words".format(
+              name, number, priority, cpu, stack_free))
+    samples.append((uptime, {"{} #{}".format(task[0], task[1]): task[3] for task in tasks}))
+
+def save_csv():
+    names = sorted({name for _, shares in samples for name in shares})
+    with open(CSV_FILE, "w", newline="") as csv_file:
+        writer = csv.writer(csv_file)
+        writer.writerow(["uptime_s"] + names)
+        for uptime, shares in samples:
+            writer.writerow([uptime] + [shares.get(name, 0.0) for name in names])
+    print("Saved " + str(len(samples)) + " samples to " + CSV_FILE)
+    return names
+
+def plot(names):
+    try:
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print("Install matplotlib to plot the samples")
+        return
+    times = [uptime for uptime, _ in samples]
+    shares = [[sample.get(name, 0.0) for _, sample in samples] for name in names]
+    plt.stackplot(times, shares, labels=names)
+    plt.xlabel("Uptime (s)")
+    plt.ylabel("CPU (%)")
+    plt.ylim(0, 100)
+    plt.legend(loc="upper left", fontsize="small")
+    plt.title("CPU share per task")
+    plt.show()
+
+client = mqtt.Client(MQTT_CLIENT_ID)
+client.on_connect = on_connect
+client.on_message = on_message
+client.connect(BROKER_ADDRESS, BROKER_PORT)
+client.loop_start()
+
+try:
+    while True:
+        time.sleep(1)
+except KeyboardInterrupt:
+    pass
+
+client.loop_stop()
+client.disconnect()
+
+if not samples:
+    print("No telemetry received")
+    sys.exit(1)
+plot(save_csv())
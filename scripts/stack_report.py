@@ -0,0 +1,61 @@
+import re
+import sys
+
+# Merges the stack sizing reports printed by the device when an update
+# completes, e.g. one serial log of a TLS build and one of a non-TLS build:
+#   python stack_report.py tls.log no_tls.log
+# and prints the worst case of every task with the recommended size. Sizes
+# and the margin must match RTOS_STATS_STACK_* in source/rtos_stats.h.
+MARGIN_PCT = 25
+MIN_MARGIN = 256
+ALIGN = 256
+
+HEADER = re.compile(r"Stack sizing, worst case since boot")
+ROW = re.compile(r"^\s+(.+?)\s+(-|\d+)\s+(-|\d+)\s+(\d+)\s+(-?\d+)\s*$")
+
+def read_report(path):
+    # Only the last report of a log is used; it covers the most run time
+    rows = None
+    with open(path, errors="replace") as log:
+        for line in log:
+            if HEADER.search(line):
+                rows = {}
+            elif rows is not None:
+                match = ROW.match(line)
+                if match:
+                    name, size, _, free, _ = match.groups()
+                    rows[name] = (None if size == "-" else int(size), int(free))
+    return rows or {}
+
+def recommend(size, free):
+    if size is None:
+        shrink = max(free - MIN_MARGIN, 0)
+        return "-{}".format((shrink // ALIGN) * ALIGN)
+    peak = max(size - free, 0)
+    margin = max((peak * MARGIN_PCT) // 100, MIN_MARGIN)
+    return str(((peak + margin + ALIGN - 1) // ALIGN) * ALIGN)
+
+if len(sys.argv) < 2:
+    print("usage: stack_report.py LOG [LOG...]")
+    sys.exit(1)
+
+merged = {}
+for path in sys.argv[1:]:
+    report = read_report(path)
+    if not report:
+        print("No stack sizing report in " + path)
+    for name, (size, free) in report.items():
+        if name in merged:
+            old_size, old_free = merged[name]
+            size = size if size is not None else old_size
+            free = min(free, old_free)
+        merged[name] = (size, free)
+
+print("{:<16} {:>7} {:>7} {:>7} {:>11}".format("TASK", "SIZE", "PEAK", "FREE", "RECOMMENDED"))
+for name, (size, free) in sorted(merged.items()):
+    print("{:<16} {:>7} {:>7} {:>7} {:>11}".format(
+          name,
+          "-" if size is None else size,
+          "-" if size is None else max(size - free, 0),
+          free,
+          recommend(size, free)))
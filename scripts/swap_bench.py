@@ -0,0 +1,192 @@
+import os
+import sys
+import tempfile
+
+# Times the MCUboot upgrade modes on a flash model backed by a file, for the
+# images of this application:
+#   python swap_bench.py [--no-rollback] [NEW.bin [OLD.bin]]
+# NEW.bin is the image sent to the device and OLD.bin the one it runs; both
+# default to random data of IMAGE_SIZE. The primary slot, the secondary slot
+# and the scratch area are laid out in one file as in the Makefile. Every mode
+# moves the real bytes sector by sector, and the result is checked, so the
+# erase and program counts are those of a correct upgrade.
+#
+# The timings are the row figures of the PSoC 6 datasheet for the internal
+# flash. Writing a few bytes of status rewrites a whole row, as the flash
+# driver of MCUboot does for the internal flash. Check them against a
+# stopwatch on one upgrade before trusting the ranking.
+SECTOR_SIZE = 512               # Row of the internal flash
+ERASE_US = 11000                # Row erase
+PROGRAM_US = 5000               # Row program after erase
+STATUS_WRITE_US = ERASE_US + PROGRAM_US
+READ_US_PER_KB = 10
+ERASE_VALUE = 0x00              # CY_FLASH_ERASE_VALUE
+
+HEADER_SIZE = 0x400             # MCUBOOT_HEADER_SIZE
+SLOT_SIZE = 0xEE000             # CY_BOOT_PRIMARY_1_SIZE, CY_BOOT_SECONDARY_1_SIZE
+SCRATCH_SIZE = 0x10000          # CY_BOOT_SCRATCH_SIZE
+MAX_IMG_SECTORS = 2000          # MCUBOOT_MAX_IMG_SECTORS
+TRAILER_SECTORS = 1
+IMAGE_SIZE = 400 * 1024
+
+PRIMARY = 0
+SECONDARY = SLOT_SIZE
+SCRATCH = 2 * SLOT_SIZE
+
+class FileFlash:
+    def __init__(self, path, size):
+        self.file = open(path, "w+b")
+        self.file.write(bytes([ERASE_VALUE]) * size)
+        self.erased = bytearray([1]) * (size // SECTOR_SIZE)
+        self.erases = 0
+        self.programs = 0
+        self.status_writes = 0
+        self.wear = [0] * (size // SECTOR_SIZE)
+        self.time_us = 0
+
+    def close(self):
+        self.file.close()
+
+    def read(self, offset, length):
+        self.time_us += (length * READ_US_PER_KB) // 1024
+        self.file.seek(offset)
+        return self.file.read(length)
+
+    def erase(self, offset):
+        sector = offset // SECTOR_SIZE
+        self.file.seek(sector * SECTOR_SIZE)
+        self.file.write(bytes([ERASE_VALUE]) * SECTOR_SIZE)
+        self.erased[sector] = 1
+        self.wear[sector] += 1
+        self.erases += 1
+        self.time_us += ERASE_US
+
+    def program(self, offset, data):
+        sector = offset // SECTOR_SIZE
+        if not self.erased[sector]:
+            raise RuntimeError("program of a sector that is not erased at 0x{:x}".format(offset))
+        self.file.seek(offset)
+        self.file.write(data)
+        self.erased[sector] = 0
+        self.programs += 1
+        self.time_us += PROGRAM_US
+
+    def copy(self, src, dst):
+        data = self.read(src, SECTOR_SIZE)
+        self.erase(dst)
+        self.program(dst, data)
+
+    def write_status(self, offset):
+        # Read-modify-write of a trailer row
+        self.wear[offset // SECTOR_SIZE] += 1
+        self.status_writes += 1
+        self.time_us += STATUS_WRITE_US
+
+def sectors(size):
+    return (size + SECTOR_SIZE - 1) // SECTOR_SIZE
+
+def trailer(slot):
+    return slot + SLOT_SIZE - TRAILER_SECTORS * SECTOR_SIZE
+
+def upgrade_overwrite(flash, new_size, old_size):
+    for i in range(sectors(new_size)):
+        flash.copy(SECONDARY + i * SECTOR_SIZE, PRIMARY + i * SECTOR_SIZE)
+    # The secondary header and trailer are erased so the copy is not repeated
+    flash.erase(SECONDARY)
+    flash.erase(trailer(SECONDARY))
+
+def upgrade_swap_scratch(flash, new_size, old_size):
+    per_area = SCRATCH_SIZE // SECTOR_SIZE
+    count = sectors(max(new_size, old_size))
+    flash.write_status(trailer(PRIMARY))
+    # Areas of the scratch size, from the end of the images down
+    for first in reversed(range(0, count, per_area)):
+        area = range(first, min(first + per_area, count))
+        for i in area:
+            flash.copy(SECONDARY + i * SECTOR_SIZE, SCRATCH + (i - first) * SECTOR_SIZE)
+        flash.write_status(trailer(PRIMARY))
+        for i in area:
+            flash.copy(PRIMARY + i * SECTOR_SIZE, SECONDARY + i * SECTOR_SIZE)
+        flash.write_status(trailer(PRIMARY))
+        for i in area:
+            flash.copy(SCRATCH + (i - first) * SECTOR_SIZE, PRIMARY + i * SECTOR_SIZE)
+        flash.write_status(trailer(PRIMARY))
+
+def upgrade_swap_move(flash, new_size, old_size):
+    count = sectors(max(new_size, old_size))
+    flash.write_status(trailer(PRIMARY))
+    # Move the running image up by one sector, then swap sector by sector
+    for i in reversed(range(count)):
+        flash.copy(PRIMARY + i * SECTOR_SIZE, PRIMARY + (i + 1) * SECTOR_SIZE)
+        flash.write_status(trailer(PRIMARY))
+    for i in range(count):
+        flash.copy(SECONDARY + i * SECTOR_SIZE, PRIMARY + i * SECTOR_SIZE)
+        flash.write_status(trailer(PRIMARY))
+        flash.copy(PRIMARY + (i + 1) * SECTOR_SIZE, SECONDARY + i * SECTOR_SIZE)
+        flash.write_status(trailer(PRIMARY))
+
+# Name as in MCUBOOT_UPGRADE_MODE, upgrade function, reverts an update that
+# was not confirmed, sectors the primary slot needs besides the image
+MODES = [
+    ("overwrite", upgrade_overwrite, False, TRAILER_SECTORS),
+    ("swap_scratch", upgrade_swap_scratch, True, TRAILER_SECTORS),
+    ("swap_move", upgrade_swap_move, True, TRAILER_SECTORS + 1),
+]
+
+def run(mode, new, old):
+    name, upgrade, rollback, spare = mode
+    if sectors(max(len(new), len(old))) + spare > SLOT_SIZE // SECTOR_SIZE:
+        return None
+    with tempfile.TemporaryDirectory() as tmp:
+        flash = FileFlash(os.path.join(tmp, "flash.bin"), 2 * SLOT_SIZE + SCRATCH_SIZE)
+        for i in range(sectors(len(old))):
+            flash.program(PRIMARY + i * SECTOR_SIZE, old[i * SECTOR_SIZE:(i + 1) * SECTOR_SIZE])
+        for i in range(sectors(len(new))):
+            flash.program(SECONDARY + i * SECTOR_SIZE, new[i * SECTOR_SIZE:(i + 1) * SECTOR_SIZE])
+        flash.erases = flash.programs = flash.time_us = 0
+        flash.wear = [0] * len(flash.wear)
+
+        upgrade(flash, len(new), len(old))
+
+        if flash.read(PRIMARY, len(new)) != new:
+            raise RuntimeError(name + ": primary slot does not hold the new image")
+        if rollback and flash.read(SECONDARY, len(old)) != old:
+            raise RuntimeError(name + ": secondary slot does not hold the old image")
+        result = (flash.time_us, flash.erases, flash.programs, flash.status_writes, max(flash.wear))
+        flash.close()
+    return result
+
+def load(path):
+    with open(path, "rb") as image:
+        return image.read()
+
+args = [arg for arg in sys.argv[1:] if arg != "--no-rollback"]
+rollback_required = "--no-rollback" not in sys.argv
+new = load(args[0]) if len(args) > 0 else os.urandom(IMAGE_SIZE)
+old = load(args[1]) if len(args) > 1 else os.urandom(len(new))
+if sectors(SLOT_SIZE) > MAX_IMG_SECTORS:
+    print("warning: the slot has more sectors than MCUBOOT_MAX_IMG_SECTORS")
+
+print("New image {} bytes, old image {} bytes, {} byte sectors".format(len(new), len(old), SECTOR_SIZE))
+print("{:<14}{:>10}{:>10}{:>10}{:>10}{:>10}{:>10}".format(
+    "mode", "rollback", "time s", "erases", "programs", "status", "wear"))
+best = None
+for mode in MODES:
+    result = run(mode, new, old)
+    if result is None:
+        print("{:<14}  image does not fit the slot".format(mode[0]))
+        continue
+    time_us, erases, programs, status_writes, wear = result
+    print("{:<14}{:>10}{:>10.1f}{:>10}{:>10}{:>10}{:>10}".format(
+        mode[0], "yes" if mode[2] else "no", time_us / 1e6, erases, programs, status_writes, wear))
+    if (mode[2] or not rollback_required) and (best is None or time_us < best[1]):
+        best = (mode[0], time_us)
+
+print()
+print("A revert of an update that is not confirmed costs another swap.")
+if best is None:
+    print("No mode meets the rollback requirement for this image.")
+else:
+    print("Fastest mode {}: make MCUBOOT_UPGRADE_MODE={} OTA_ROLLBACK={}".format(
+        "with rollback" if rollback_required else "without rollback", best[0],
+        1 if rollback_required else 0))
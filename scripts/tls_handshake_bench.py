@@ -0,0 +1,75 @@
+import os
+import socket
+import ssl
+import statistics
+import time
+
+# Measures full and resumed TLS handshakes against the MQTT broker, the same
+# way the device connects. Run a local TLS mosquitto to benchmark without
+# Internet latency, e.g. a listener on port 8883 with:
+#   listener 8883
+#   cafile ca.crt
+#   certfile server.crt
+#   keyfile server.key
+BROKER_ADDRESS = "localhost"
+BROKER_PORT = 8883
+CA_CERTS = "ca.crt"
+CERT_FILE = None    # Client certificate, e.g. "client.crt" for port 8884 of test.mosquitto.org
+KEY_FILE = None     # Client key, e.g. "client.key"
+
+# Same suite as the device, so the handshake cost is comparable
+CIPHERS = "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256"
+
+# Number of handshakes of each kind
+ITERATIONS = 20
+
+def make_context():
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+    context.maximum_version = ssl.TLSVersion.TLSv1_2   # mbedTLS 2.16 on the device has no TLS 1.3
+    context.load_verify_locations(CA_CERTS)
+    context.set_ciphers(CIPHERS)
+    if CERT_FILE is not None:
+        context.load_cert_chain(CERT_FILE, KEY_FILE)
+    if BROKER_ADDRESS in ("localhost", "127.0.0.1"):
+        context.check_hostname = False
+    return context
+
+def handshake(context, session=None):
+    sock = socket.create_connection((BROKER_ADDRESS, BROKER_PORT))
+    start = time.perf_counter()
+    tls = context.wrap_socket(sock, server_hostname=BROKER_ADDRESS, session=session)
+    elapsed = (time.perf_counter() - start) * 1000
+    result = (elapsed, tls.session, tls.session_reused)
+    tls.close()
+    return result
+
+def report(name, samples):
+    if not samples:
+        print(name + ": no samples")
+        return
+    print("{:<8} n={:<3} min={:7.2f} ms  median={:7.2f} ms  max={:7.2f} ms".format(
+          name, len(samples), min(samples), statistics.median(samples), max(samples)))
+
+context = make_context()
+full = []
+resumed = []
+not_resumed = 0
+
+for i in range(ITERATIONS):
+    elapsed, session, _ = handshake(context)
+    full.append(elapsed)
+
+    elapsed, _, reused = handshake(context, session)
+    if reused:
+        resumed.append(elapsed)
+    else:
+        not_resumed += 1
+
+print("TLS handshakes with " + BROKER_ADDRESS + ":" + str(BROKER_PORT) + os.linesep)
+report("full", full)
+report("resumed", resumed)
+if not_resumed:
+    print(str(not_resumed) + " resumption attempts were refused by the broker")
+if full and resumed:
+    print("Resumption saves {:.2f} ms per connection".format(
+          statistics.median(full) - statistics.median(resumed)))
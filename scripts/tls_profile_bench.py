@@ -0,0 +1,93 @@
+import re
+import subprocess
+import sys
+import time
+
+import serial
+
+# Builds and programs the application once per TLS profile with the ECC
+# benchmark enabled, and compares the results printed by the kit. Then builds
+# the application with each key exchange and compares the image sizes. Run from the
+# scripts directory with the kit connected; requires pyserial and the
+# ModusToolbox make environment.
+KIT = "CY8CPROTO-062-4343W"
+TOOLCHAIN = "GCC_ARM"
+SERIAL_PORT = "/dev/ttyACM0"    # KitProg3 UART, e.g. "COM5" on Windows
+BAUD_RATE = 115200
+PROFILES = ["DEFAULT", "SPEED", "SIZE"]
+
+# Key exchanges compared by image size only; their handshake time is printed
+# by the device on every connection ("TLS handshake with ...")
+KEY_EXCHANGES = ["CERT", "ECDHE_PSK", "PSK"]
+
+# Seconds to wait for the benchmark output after programming
+BENCH_TIMEOUT = 120
+
+# Application image to measure the flash and RAM footprint of each profile
+ELF_FILE = "../build/" + KIT + "/Debug/mtb-example-anycloud-ota-mqtt.elf"
+
+RESULT_LINE = re.compile(r"ECC bench \[(\w+)\] (\w+): min (\d+) max (\d+) avg (\d+) cycles \((\d+) ms\)")
+HEAP_LINE = re.compile(r"ECC bench \[(\w+)\] heap: (\d+) bytes peak")
+
+def build_and_program(profile):
+    print("Building and programming the " + profile + " profile...")
+    subprocess.run(["make", "-C", "..", "program", "TARGET=" + KIT, "TOOLCHAIN=" + TOOLCHAIN,
+                    "TLS_PROFILE=" + profile, "ECC_BENCHMARK=1"], check=True,
+                   stdout=subprocess.DEVNULL)
+
+def build(key_exchange):
+    print("Building with the " + key_exchange + " key exchange...")
+    subprocess.run(["make", "-C", "..", "build", "TARGET=" + KIT, "TOOLCHAIN=" + TOOLCHAIN,
+                    "TLS_KEY_EXCHANGE=" + key_exchange], check=True, stdout=subprocess.DEVNULL)
+
+def image_size():
+    output = subprocess.run(["arm-none-eabi-size", ELF_FILE], check=True,
+                            capture_output=True, text=True).stdout.splitlines()[1].split()
+    text, data, bss = int(output[0]), int(output[1]), int(output[2])
+    return text + data, data + bss
+
+def read_results(port):
+    results = {}
+    heap = None
+    deadline = time.time() + BENCH_TIMEOUT
+    while time.time() < deadline:
+        line = port.readline().decode("ascii", errors="replace").strip()
+        match = RESULT_LINE.search(line)
+        if match:
+            results[match.group(2)] = (int(match.group(5)), int(match.group(6)), int(match.group(4)))
+        match = HEAP_LINE.search(line)
+        if match:
+            heap = int(match.group(2))
+        if "ECC bench done" in line or "ECC bench [" in line and "failed" in line:
+            return results, heap
+    print("Timed out waiting for the benchmark output")
+    return results, heap
+
+summary = {}
+with serial.Serial(SERIAL_PORT, BAUD_RATE, timeout=1) as port:
+    for profile in PROFILES:
+        port.reset_input_buffer()
+        build_and_program(profile)
+        results, heap = read_results(port)
+        flash, ram = image_size()
+        summary[profile] = (results, heap, flash, ram)
+
+for profile, (results, heap, flash, ram) in summary.items():
+    print("")
+    print(profile + " profile: flash " + str(flash) + " bytes, static RAM " + str(ram) +
+          " bytes, ECC peak heap " + str(heap) + " bytes")
+    total = 0
+    for name, (avg, ms, worst) in results.items():
+        print("  {:<14} avg {:>10} cycles {:>6} ms   max {:>10} cycles".format(name, avg, ms, worst))
+        total += avg
+    # A client handshake with a client certificate does one of each operation
+    print("  {:<14} avg {:>10} cycles".format("handshake", total))
+
+print("")
+for key_exchange in KEY_EXCHANGES:
+    build(key_exchange)
+    flash, ram = image_size()
+    print("{:<10} key exchange: flash {:>8} bytes, static RAM {:>7} bytes".format(key_exchange, flash, ram))
+
+if len(summary) < len(PROFILES):
+    sys.exit(1)
@@ -0,0 +1,302 @@
+/******************************************************************************
+* File Name: app_nvm.c
+*
+* Description: This file contains functions used to keep small application
+* records in the auxiliary (work) flash so that they survive a reboot. Every
+* record owns a single flash row and is protected by a CRC so that a torn or
+* stale write is reported as "not found" instead of being returned.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include <string.h>
+
+/* FreeRTOS header file */
+#include <FreeRTOS.h>
+#include <semphr.h>
+
+#include "app_nvm.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Start of the rows reserved for application records. Defaults to the start
+ * of the auxiliary flash, which is not used by MCUBoot or the OTA agent. */
+#ifndef APP_NVM_BASE_ADDR
+#define APP_NVM_BASE_ADDR                   (CY_EM_EEPROM_BASE)
+#endif
+
+/* Marks a row that holds a valid record */
+#define APP_NVM_RECORD_MAGIC                (0x314D564Eu)   /* "NVM1" */
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* Layout of a record row */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t size;
+    uint16_t id;
+    uint32_t crc;
+    uint8_t  data[APP_NVM_MAX_RECORD_SIZE];
+} app_nvm_row_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static cyhal_flash_t nvm_flash;
+static SemaphoreHandle_t nvm_mutex;
+
+/* Row image used for read-modify-write; guarded by nvm_mutex */
+static app_nvm_row_t nvm_row;
+
+/*******************************************************************************
+ * Function Name: app_nvm_crc32
+ *******************************************************************************
+ * Summary:
+ *  Computes a CRC-32 (IEEE 802.3) over the given buffer. Also used by callers
+ *  to fingerprint the configuration a cached record was derived from.
+ *
+ *******************************************************************************/
+uint32_t app_nvm_crc32(const void *buf, uint32_t size)
+{
+    const uint8_t *data = (const uint8_t *)buf;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    while (size-- > 0u)
+    {
+        crc ^= *data++;
+        for (uint32_t bit = 0; bit < 8u; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+
+    return ~crc;
+}
+
+/*******************************************************************************
+ * Function Name: app_nvm_init
+ *******************************************************************************
+ * Summary:
+ *  Initializes the flash driver used to store the application records. Must be
+ *  called once from a task context before any other app_nvm function.
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS or the flash driver error
+ *
+ *******************************************************************************/
+cy_rslt_t app_nvm_init(void)
+{
+    cy_rslt_t result;
+
+    if (nvm_mutex != NULL)
+    {
+        return CY_RSLT_SUCCESS;
+    }
+
+    CY_ASSERT(sizeof(app_nvm_row_t) == APP_NVM_ROW_SIZE);
+
+    result = cyhal_flash_init(&nvm_flash);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        return result;
+    }
+
+    nvm_mutex = xSemaphoreCreateMutex();
+    if (nvm_mutex == NULL)
+    {
+        cyhal_flash_free(&nvm_flash);
+        return APP_NVM_RSLT_ERR_FLASH;
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: app_nvm_read
+ *******************************************************************************
+ * Summary:
+ *  Reads a record. The stored record must have exactly the requested size,
+ *  which lets callers invalidate old records by changing their layout.
+ *
+ * Parameters:
+ *  app_nvm_id_t id : Record identifier
+ *  void *data      : Buffer that receives the record
+ *  uint32_t size   : Size of the record
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, APP_NVM_RSLT_ERR_NOT_FOUND when the row
+ *              does not hold a valid record of this size, or
+ *              APP_NVM_RSLT_ERR_FLASH when the store is not initialized
+ *
+ *******************************************************************************/
+cy_rslt_t app_nvm_read(app_nvm_id_t id, void *data, uint32_t size)
+{
+    cy_rslt_t result = APP_NVM_RSLT_ERR_NOT_FOUND;
+
+    if ((id >= APP_NVM_ID_MAX) || (data == NULL) || (size > APP_NVM_MAX_RECORD_SIZE))
+    {
+        return APP_NVM_RSLT_ERR_BAD_ARG;
+    }
+
+    /* app_nvm_init() failed or was not called */
+    if (nvm_mutex == NULL)
+    {
+        return APP_NVM_RSLT_ERR_FLASH;
+    }
+
+    xSemaphoreTake(nvm_mutex, portMAX_DELAY);
+
+    if (cyhal_flash_read(&nvm_flash, APP_NVM_BASE_ADDR + (id * APP_NVM_ROW_SIZE),
+                         (uint8_t *)&nvm_row, sizeof(nvm_row)) != CY_RSLT_SUCCESS)
+    {
+        result = APP_NVM_RSLT_ERR_FLASH;
+    }
+    else if ((nvm_row.magic == APP_NVM_RECORD_MAGIC) && (nvm_row.id == id) &&
+             (nvm_row.size == size) && (nvm_row.crc == app_nvm_crc32(nvm_row.data, size)))
+    {
+        memcpy(data, nvm_row.data, size);
+        result = CY_RSLT_SUCCESS;
+    }
+
+    xSemaphoreGive(nvm_mutex);
+
+    return result;
+}
+
+/*******************************************************************************
+ * Function Name: app_nvm_write
+ *******************************************************************************
+ * Summary:
+ *  Writes a record. The row is left untouched when it already holds the same
+ *  record, so callers may save unconditionally without wearing the flash.
+ *
+ * Parameters:
+ *  app_nvm_id_t id  : Record identifier
+ *  const void *data : Record contents
+ *  uint32_t size    : Size of the record
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS or an error code; APP_NVM_RSLT_ERR_FLASH
+ *              when the store is not initialized
+ *
+ *******************************************************************************/
+cy_rslt_t app_nvm_write(app_nvm_id_t id, const void *data, uint32_t size)
+{
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+    uint32_t address;
+
+    if ((id >= APP_NVM_ID_MAX) || (data == NULL) || (size > APP_NVM_MAX_RECORD_SIZE))
+    {
+        return APP_NVM_RSLT_ERR_BAD_ARG;
+    }
+
+    /* app_nvm_init() failed or was not called */
+    if (nvm_mutex == NULL)
+    {
+        return APP_NVM_RSLT_ERR_FLASH;
+    }
+
+    address = APP_NVM_BASE_ADDR + (id * APP_NVM_ROW_SIZE);
+
+    xSemaphoreTake(nvm_mutex, portMAX_DELAY);
+
+    /* Skip the write if the row already holds this record */
+    if ((cyhal_flash_read(&nvm_flash, address, (uint8_t *)&nvm_row, sizeof(nvm_row)) != CY_RSLT_SUCCESS) ||
+        (nvm_row.magic != APP_NVM_RECORD_MAGIC) || (nvm_row.id != id) ||
+        (nvm_row.size != size) || (memcmp(nvm_row.data, data, size) != 0))
+    {
+        memset(&nvm_row, 0, sizeof(nvm_row));
+        nvm_row.magic = APP_NVM_RECORD_MAGIC;
+        nvm_row.size = (uint16_t)size;
+        nvm_row.id = (uint16_t)id;
+        memcpy(nvm_row.data, data, size);
+        nvm_row.crc = app_nvm_crc32(nvm_row.data, size);
+
+        if (cyhal_flash_write(&nvm_flash, address, (const uint32_t *)&nvm_row) != CY_RSLT_SUCCESS)
+        {
+            result = APP_NVM_RSLT_ERR_FLASH;
+        }
+    }
+
+    xSemaphoreGive(nvm_mutex);
+
+    return result;
+}
+
+/*******************************************************************************
+ * Function Name: app_nvm_erase
+ *******************************************************************************
+ * Summary:
+ *  Invalidates a record.
+ *
+ * Parameters:
+ *  app_nvm_id_t id : Record identifier
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS or an error code; APP_NVM_RSLT_ERR_FLASH
+ *              when the store is not initialized
+ *
+ *******************************************************************************/
+cy_rslt_t app_nvm_erase(app_nvm_id_t id)
+{
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+
+    if (id >= APP_NVM_ID_MAX)
+    {
+        return APP_NVM_RSLT_ERR_BAD_ARG;
+    }
+
+    /* app_nvm_init() failed or was not called */
+    if (nvm_mutex == NULL)
+    {
+        return APP_NVM_RSLT_ERR_FLASH;
+    }
+
+    xSemaphoreTake(nvm_mutex, portMAX_DELAY);
+
+    if (cyhal_flash_erase(&nvm_flash, APP_NVM_BASE_ADDR + (id * APP_NVM_ROW_SIZE)) != CY_RSLT_SUCCESS)
+    {
+        result = APP_NVM_RSLT_ERR_FLASH;
+    }
+
+    xSemaphoreGive(nvm_mutex);
+
+    return result;
+}
+
+/* [] END OF FILE */
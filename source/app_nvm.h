@@ -0,0 +1,83 @@
+/******************************************************************************
+* File Name: app_nvm.h
+*
+* Description: This file contains declarations of the functions used to keep
+* small application records in the auxiliary (work) flash across reboots.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_APP_NVM_H_
+#define SOURCE_APP_NVM_H_
+
+#include "cy_result.h"
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Result codes returned by the app_nvm functions */
+#define APP_NVM_RSLT_MODULE                 (CY_RSLT_MODULE_MIDDLEWARE_BASE + 0xF0u)
+#define APP_NVM_RSLT_ERR_BAD_ARG            CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, APP_NVM_RSLT_MODULE, 1)
+#define APP_NVM_RSLT_ERR_NOT_FOUND          CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, APP_NVM_RSLT_MODULE, 2)
+#define APP_NVM_RSLT_ERR_FLASH              CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, APP_NVM_RSLT_MODULE, 3)
+
+/* Size of one record slot. Each record occupies one flash row. */
+#define APP_NVM_ROW_SIZE                    (512u)
+
+/* Largest payload that fits into a record slot (row minus record header) */
+#define APP_NVM_MAX_RECORD_SIZE             (APP_NVM_ROW_SIZE - 12u)
+
+/*******************************************************************************
+* Data structures and enumerations
+********************************************************************************/
+/* Record identifiers. Every identifier owns one row of the work flash. */
+typedef enum
+{
+    APP_NVM_ID_WIFI_CACHE = 0,  /* Last successful Wi-Fi join parameters */
+    APP_NVM_ID_NET_LEASE,       /* DHCP lease saved before an intentional reboot */
+    APP_NVM_ID_DNS_CACHE,       /* Last resolved addresses of the MQTT broker */
+    APP_NVM_ID_TLS_SESSION,     /* TLS session of the MQTT connection */
+    APP_NVM_ID_OTA_REBOOT,      /* Downtime measurement of a reboot into an update */
+    APP_NVM_ID_MAX
+} app_nvm_id_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t app_nvm_init(void);
+cy_rslt_t app_nvm_read(app_nvm_id_t id, void *data, uint32_t size);
+cy_rslt_t app_nvm_write(app_nvm_id_t id, const void *data, uint32_t size);
+cy_rslt_t app_nvm_erase(app_nvm_id_t id);
+uint32_t app_nvm_crc32(const void *buf, uint32_t size);
+
+#endif /* SOURCE_APP_NVM_H_ */
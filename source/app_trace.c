@@ -0,0 +1,275 @@
+/******************************************************************************
+* File Name: app_trace.c
+*
+* Description: This file contains functions used to record a timeline of named
+* steps. Each step is recorded with the task that ran it, so the dump shows
+* which steps overlap and which ones are on the critical path. A ring of
+* phase marks timed with the tick count and SysTick breaks down shorter
+* sequences, such as the phases of a connection. Unlike the DWT cycle
+* counter, the tick count is kept across the sleep of tickless idle, which
+* takes up most of the network waits being traced.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <string.h>
+
+/* FreeRTOS header file */
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "app_trace.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Length of a tick */
+#define APP_TRACE_TICK_US                   (portTICK_PERIOD_MS * 1000u)
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* A recorded step */
+typedef struct
+{
+    const char *name;
+    const char *task;
+    TickType_t begin;
+    TickType_t end;
+} app_trace_event_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static app_trace_event_t trace_events[APP_TRACE_MAX_EVENTS];
+static uint32_t trace_count;
+
+static app_trace_mark_t trace_ring[APP_TRACE_RING_SIZE];
+static uint32_t trace_ring_head;    /* Next slot to write */
+static uint32_t trace_ring_count;
+
+/*******************************************************************************
+ * Function Name: app_trace_begin
+ *******************************************************************************
+ * Summary:
+ *  Records the start of a step. The name must be a string literal, or must
+ *  otherwise outlive the trace.
+ *
+ * Parameters:
+ *  const char *name : Name of the step
+ *
+ *******************************************************************************/
+void app_trace_begin(const char *name)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    if (trace_count < APP_TRACE_MAX_EVENTS)
+    {
+        trace_events[trace_count].name = name;
+        trace_events[trace_count].task = pcTaskGetName(NULL);
+        trace_events[trace_count].begin = now;
+        trace_events[trace_count].end = now;
+        trace_count++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: app_trace_end
+ *******************************************************************************
+ * Summary:
+ *  Records the end of the most recent step with the given name.
+ *
+ * Parameters:
+ *  const char *name : Name of the step, as passed to app_trace_begin()
+ *
+ *******************************************************************************/
+void app_trace_end(const char *name)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    for (uint32_t i = trace_count; i > 0u; i--)
+    {
+        if (strcmp(trace_events[i - 1u].name, name) == 0)
+        {
+            trace_events[i - 1u].end = now;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: app_trace_dump
+ *******************************************************************************
+ * Summary:
+ *  Prints the recorded steps in start order, in milliseconds since boot.
+ *
+ * Parameters:
+ *  const char *title : Heading of the dump
+ *
+ *******************************************************************************/
+void app_trace_dump(const char *title)
+{
+    printf("\n%s (ms since boot)\n", title);
+    printf("  %8s %8s %8s  %-16s %s\n", "begin", "end", "length", "task", "step");
+
+    for (uint32_t i = 0; i < trace_count; i++)
+    {
+        printf("  %8lu %8lu %8lu  %-16s %s\n",
+               (unsigned long)(trace_events[i].begin * portTICK_PERIOD_MS),
+               (unsigned long)(trace_events[i].end * portTICK_PERIOD_MS),
+               (unsigned long)((trace_events[i].end - trace_events[i].begin) * portTICK_PERIOD_MS),
+               trace_events[i].task,
+               trace_events[i].name);
+    }
+    printf("\n");
+}
+
+/*******************************************************************************
+ * Function Name: app_trace_mark
+ *******************************************************************************
+ * Summary:
+ *  Records a point in a sequence of phases, such as the steps of a connection,
+ *  in the phase ring: the tick count, and the part of the current tick elapsed
+ *  on SysTick. After tickless idle, the current tick starts when SysTick is
+ *  restarted. The name must be a string literal, or must otherwise outlive
+ *  the trace.
+ *
+ * Parameters:
+ *  const char *name : Name of the phase that starts or ends at this point
+ *
+ *******************************************************************************/
+void app_trace_mark(const char *name)
+{
+    uint32_t tick;
+    uint32_t load;
+    uint32_t elapsed;
+
+    taskENTER_CRITICAL();
+    tick = (uint32_t)xTaskGetTickCount();
+    load = SysTick->LOAD + 1u;
+    elapsed = load - SysTick->VAL;
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0u)
+    {
+        /* The tick ran out, but its interrupt waits for the critical section */
+        tick++;
+        elapsed = load - SysTick->VAL;
+    }
+
+    trace_ring[trace_ring_head].name = name;
+    trace_ring[trace_ring_head].tick = tick;
+    trace_ring[trace_ring_head].tick_us = (uint32_t)(((uint64_t)elapsed * APP_TRACE_TICK_US) / load);
+    trace_ring_head = (trace_ring_head + 1u) % APP_TRACE_RING_SIZE;
+    if (trace_ring_count < APP_TRACE_RING_SIZE)
+    {
+        trace_ring_count++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: app_trace_ring_read
+ *******************************************************************************
+ * Summary:
+ *  Moves the phase marks out of the ring, oldest first. Marks that do not fit
+ *  in the buffer stay in the ring.
+ *
+ * Parameters:
+ *  app_trace_mark_t *marks : Buffer for the marks
+ *  uint32_t max_marks      : Number of marks that fit in the buffer
+ *
+ * Return:
+ *  uint32_t : Number of marks copied
+ *
+ *******************************************************************************/
+uint32_t app_trace_ring_read(app_trace_mark_t *marks, uint32_t max_marks)
+{
+    uint32_t count;
+    uint32_t tail;
+
+    taskENTER_CRITICAL();
+    count = (trace_ring_count < max_marks) ? trace_ring_count : max_marks;
+    tail = (trace_ring_head + APP_TRACE_RING_SIZE - trace_ring_count) % APP_TRACE_RING_SIZE;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        marks[i] = trace_ring[(tail + i) % APP_TRACE_RING_SIZE];
+    }
+    trace_ring_count -= count;
+    taskEXIT_CRITICAL();
+
+    return count;
+}
+
+/*******************************************************************************
+ * Function Name: app_trace_ring_dump
+ *******************************************************************************
+ * Summary:
+ *  Prints and empties the phase ring: the time of every mark in milliseconds
+ *  since boot and the time since the previous mark in microseconds.
+ *
+ * Parameters:
+ *  const char *title : Heading of the dump
+ *
+ *******************************************************************************/
+void app_trace_ring_dump(const char *title)
+{
+    app_trace_mark_t mark;
+    app_trace_mark_t prev = { 0 };
+    uint32_t delta_us;
+    bool first = true;
+
+    printf("\n%s\n", title);
+    printf("  %8s %10s  %s\n", "ms", "+us", "phase");
+
+    while (app_trace_ring_read(&mark, 1u) == 1u)
+    {
+        delta_us = 0u;
+        if (!first)
+        {
+            delta_us = ((mark.tick - prev.tick) * APP_TRACE_TICK_US) + mark.tick_us - prev.tick_us;
+        }
+        printf("  %8lu %10lu  %s\n", (unsigned long)(mark.tick * portTICK_PERIOD_MS),
+               (unsigned long)delta_us, mark.name);
+        prev = mark;
+        first = false;
+    }
+    printf("\n");
+}
+
+/* [] END OF FILE */
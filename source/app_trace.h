@@ -0,0 +1,79 @@
+/******************************************************************************
+* File Name: app_trace.h
+*
+* Description: This file contains declarations of the functions used to
+* record a timeline of named events, e.g. the steps of the startup sequence.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_APP_TRACE_H_
+#define SOURCE_APP_TRACE_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Number of events kept by the trace; later events are dropped */
+#ifndef APP_TRACE_MAX_EVENTS
+#define APP_TRACE_MAX_EVENTS                (32u)
+#endif
+
+/* Number of phase marks kept by the ring; the oldest are overwritten */
+#ifndef APP_TRACE_RING_SIZE
+#define APP_TRACE_RING_SIZE                 (64u)
+#endif
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* A phase mark: tick count, and the microseconds elapsed in the tick for
+ * sub-millisecond resolution */
+typedef struct
+{
+    const char *name;
+    uint32_t tick;
+    uint32_t tick_us;
+} app_trace_mark_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void app_trace_begin(const char *name);
+void app_trace_end(const char *name);
+void app_trace_dump(const char *title);
+void app_trace_mark(const char *name);
+uint32_t app_trace_ring_read(app_trace_mark_t *marks, uint32_t max_marks);
+void app_trace_ring_dump(const char *title);
+
+#endif /* SOURCE_APP_TRACE_H_ */
@@ -0,0 +1,302 @@
+/******************************************************************************
+* File Name: conn_trace.c
+*
+* Description: This file contains the connection phase tracer. It wraps the
+* secure sockets and MQTT calls made by the OTA agent, using the --wrap option
+* of the GNU linker, and marks the start and end of every phase in the phase
+* ring of app_trace: DNS resolution, TCP connection, TLS handshake (marked by
+* ota_tls.c), MQTT CONNECT/CONNACK and SUBSCRIBE/SUBACK. In builds with
+* CONN_TRACE=1, the ring is printed once the subscription completes.
+*
+* The MQTT connection of the agent is also kept while it is open, so that the
+* application can publish telemetry on it with conn_trace_publish().
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+
+#include <string.h>
+
+/* FreeRTOS header files */
+#include <FreeRTOS.h>
+#include <semphr.h>
+
+/* Secure sockets and MQTT header files */
+#include "cy_secure_sockets.h"
+#include "iot_mqtt.h"
+
+#include "app_trace.h"
+#include "ota_carousel.h"
+#include "conn_trace.h"
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Bytes received on all sockets since boot */
+static volatile uint32_t conn_rx_bytes;
+
+#if defined(CONN_TRACE_HOOKS)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t __real_cy_socket_gethostbyname(const char *hostname, cy_socket_ip_version_t ip_ver,
+                                         cy_socket_ip_address_t *addr);
+cy_rslt_t __real_cy_socket_connect(cy_socket_t handle, cy_socket_sockaddr_t *address, uint32_t address_length);
+IotMqttError_t __real_IotMqtt_Connect(const IotMqttNetworkInfo_t *pNetworkInfo,
+                                      const IotMqttConnectInfo_t *pConnectInfo,
+                                      uint32_t timeoutMs, IotMqttConnection_t * const pMqttConnection);
+IotMqttError_t __real_IotMqtt_TimedSubscribe(IotMqttConnection_t mqttConnection,
+                                             const IotMqttSubscription_t *pSubscriptionList,
+                                             size_t subscriptionCount, uint32_t flags, uint32_t timeoutMs);
+void __real_IotMqtt_Disconnect(IotMqttConnection_t mqttConnection, uint32_t flags);
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Open MQTT connection of the OTA agent, or IOT_MQTT_CONNECTION_INITIALIZER */
+static IotMqttConnection_t conn_mqtt = IOT_MQTT_CONNECTION_INITIALIZER;
+
+/* Keeps the connection open while a message is published on it */
+static SemaphoreHandle_t conn_mutex;
+
+/*******************************************************************************
+ * Function Name: __wrap_cy_socket_gethostbyname
+ *******************************************************************************
+ * Summary:
+ *  Marks the DNS resolution of the broker.
+ *
+ *******************************************************************************/
+cy_rslt_t __wrap_cy_socket_gethostbyname(const char *hostname, cy_socket_ip_version_t ip_ver,
+                                         cy_socket_ip_address_t *addr)
+{
+    cy_rslt_t result;
+
+    app_trace_mark("dns resolve");
+    result = __real_cy_socket_gethostbyname(hostname, ip_ver, addr);
+    app_trace_mark((result == CY_RSLT_SUCCESS) ? "dns resolved" : "dns failed");
+
+    return result;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_cy_socket_connect
+ *******************************************************************************
+ * Summary:
+ *  Marks the connection of a socket. The TCP handshake ends at the first TLS
+ *  mark of a secure socket, or at "socket connected" otherwise.
+ *
+ *******************************************************************************/
+cy_rslt_t __wrap_cy_socket_connect(cy_socket_t handle, cy_socket_sockaddr_t *address, uint32_t address_length)
+{
+    cy_rslt_t result;
+
+    app_trace_mark("tcp connect");
+    result = __real_cy_socket_connect(handle, address, address_length);
+    app_trace_mark((result == CY_RSLT_SUCCESS) ? "socket connected" : "socket connect failed");
+
+    return result;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_IotMqtt_Connect
+ *******************************************************************************
+ * Summary:
+ *  Marks the MQTT CONNECT and the CONNACK of the broker, and keeps the
+ *  connection for conn_trace_publish().
+ *
+ *******************************************************************************/
+IotMqttError_t __wrap_IotMqtt_Connect(const IotMqttNetworkInfo_t *pNetworkInfo,
+                                      const IotMqttConnectInfo_t *pConnectInfo,
+                                      uint32_t timeoutMs, IotMqttConnection_t * const pMqttConnection)
+{
+    IotMqttError_t result;
+
+    app_trace_mark("mqtt connect");
+    result = __real_IotMqtt_Connect(pNetworkInfo, pConnectInfo, timeoutMs, pMqttConnection);
+    app_trace_mark((result == IOT_MQTT_SUCCESS) ? "mqtt connack" : "mqtt connect failed");
+
+    /* The agent connects from a single thread, so the first connect creates the mutex */
+    if (conn_mutex == NULL)
+    {
+        conn_mutex = xSemaphoreCreateMutex();
+    }
+    if ((result == IOT_MQTT_SUCCESS) && (conn_mutex != NULL))
+    {
+        xSemaphoreTake(conn_mutex, portMAX_DELAY);
+        conn_mqtt = *pMqttConnection;
+        xSemaphoreGive(conn_mutex);
+    }
+
+    return result;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_IotMqtt_TimedSubscribe
+ *******************************************************************************
+ * Summary:
+ *  Marks the MQTT SUBSCRIBE to the OTA topics and the SUBACK of the broker,
+ *  which ends the connection sequence, and prints the phases if the trace
+ *  was requested with CONN_TRACE_DUMP. In the carousel
+ *  mode, the messages go through the filter of ota_carousel.c first.
+ *
+ *******************************************************************************/
+IotMqttError_t __wrap_IotMqtt_TimedSubscribe(IotMqttConnection_t mqttConnection,
+                                             const IotMqttSubscription_t *pSubscriptionList,
+                                             size_t subscriptionCount, uint32_t flags, uint32_t timeoutMs)
+{
+    IotMqttError_t result;
+
+    app_trace_mark("mqtt subscribe");
+    result = __real_IotMqtt_TimedSubscribe(mqttConnection,
+                                           ota_carousel_subscriptions(pSubscriptionList, subscriptionCount),
+                                           subscriptionCount, flags, timeoutMs);
+    app_trace_mark((result == IOT_MQTT_SUCCESS) ? "mqtt suback" : "mqtt subscribe failed");
+
+#if defined(CONN_TRACE_DUMP)
+    app_trace_ring_dump("Connection phases");
+#endif
+
+    return result;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_IotMqtt_Disconnect
+ *******************************************************************************
+ * Summary:
+ *  Forgets the connection before the agent closes it, once no message is being
+ *  published on it.
+ *
+ *******************************************************************************/
+void __wrap_IotMqtt_Disconnect(IotMqttConnection_t mqttConnection, uint32_t flags)
+{
+    if (conn_mutex != NULL)
+    {
+        xSemaphoreTake(conn_mutex, portMAX_DELAY);
+        if (conn_mqtt == mqttConnection)
+        {
+            conn_mqtt = IOT_MQTT_CONNECTION_INITIALIZER;
+        }
+        xSemaphoreGive(conn_mutex);
+    }
+
+    __real_IotMqtt_Disconnect(mqttConnection, flags);
+}
+
+#endif /* CONN_TRACE_HOOKS */
+
+/*******************************************************************************
+ * Function Name: conn_trace_rx
+ *******************************************************************************
+ * Summary:
+ *  Counts the bytes of a socket read, from the socket receive hook of
+ *  ota_throttle.c. The MQTT library receives on its own thread only, so the
+ *  counter has a single writer.
+ *
+ * Parameters:
+ *  uint32_t bytes : Bytes returned by the read
+ *
+ *******************************************************************************/
+void conn_trace_rx(uint32_t bytes)
+{
+    conn_rx_bytes += bytes;
+}
+
+/*******************************************************************************
+ * Function Name: conn_trace_rx_bytes
+ *******************************************************************************
+ * Summary:
+ *  Returns the bytes received on all sockets since boot, wrapping around at
+ *  4 GB, for throughput displays. Always 0 without the GCC_ARM toolchain.
+ *
+ *******************************************************************************/
+uint32_t conn_trace_rx_bytes(void)
+{
+    return conn_rx_bytes;
+}
+
+/*******************************************************************************
+ * Function Name: conn_trace_publish
+ *******************************************************************************
+ * Summary:
+ *  Publishes a message with QoS 0 on the MQTT connection of the OTA agent.
+ *  Messages are dropped while the agent is not connected.
+ *
+ * Parameters:
+ *  const char *topic   : Topic name
+ *  const void *payload : Message
+ *  size_t length       : Length of the message in bytes
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, CONN_TRACE_RSLT_ERR_NOT_CONNECTED, or
+ *              CONN_TRACE_RSLT_ERR_PUBLISH
+ *
+ *******************************************************************************/
+cy_rslt_t conn_trace_publish(const char *topic, const void *payload, size_t length)
+{
+#if defined(CONN_TRACE_HOOKS)
+    IotMqttPublishInfo_t publish_info = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    cy_rslt_t result = CONN_TRACE_RSLT_ERR_NOT_CONNECTED;
+
+    if (conn_mutex == NULL)
+    {
+        return result;
+    }
+
+    publish_info.qos = IOT_MQTT_QOS_0;
+    publish_info.pTopicName = topic;
+    publish_info.topicNameLength = (uint16_t)strlen(topic);
+    publish_info.pPayload = payload;
+    publish_info.payloadLength = length;
+
+    xSemaphoreTake(conn_mutex, portMAX_DELAY);
+    if (conn_mqtt != IOT_MQTT_CONNECTION_INITIALIZER)
+    {
+        result = (IotMqtt_Publish(conn_mqtt, &publish_info, 0, NULL, NULL) == IOT_MQTT_SUCCESS) ?
+                 CY_RSLT_SUCCESS : CONN_TRACE_RSLT_ERR_PUBLISH;
+    }
+    xSemaphoreGive(conn_mutex);
+
+    return result;
+#else
+    (void)topic;
+    (void)payload;
+    (void)length;
+    return CONN_TRACE_RSLT_ERR_NOT_CONNECTED;
+#endif
+}
+
+/* [] END OF FILE */
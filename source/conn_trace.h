@@ -0,0 +1,61 @@
+/******************************************************************************
+* File Name: conn_trace.h
+*
+* Description: This file contains declarations of the connection phase tracer
+* and of the publishing on the MQTT connection of the OTA agent.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_CONN_TRACE_H_
+#define SOURCE_CONN_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cy_result.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Result codes */
+#define CONN_TRACE_RSLT_MODULE              (CY_RSLT_MODULE_MIDDLEWARE_BASE + 0xF3u)
+#define CONN_TRACE_RSLT_ERR_NOT_CONNECTED   CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, CONN_TRACE_RSLT_MODULE, 1)
+#define CONN_TRACE_RSLT_ERR_PUBLISH         CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, CONN_TRACE_RSLT_MODULE, 2)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t conn_trace_publish(const char *topic, const void *payload, size_t length);
+void conn_trace_rx(uint32_t bytes);
+uint32_t conn_trace_rx_bytes(void);
+
+#endif /* SOURCE_CONN_TRACE_H_ */
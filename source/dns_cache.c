@@ -0,0 +1,430 @@
+/******************************************************************************
+* File Name: dns_cache.c
+*
+* Description: This file contains the broker address cache. The addresses of
+* the broker are installed in the lwIP local host list, so every lookup made
+* by the MQTT connection is answered without a network round trip. The cache
+* is refreshed in the background by racing an A and an AAAA query, persisted
+* in flash for the next boot, and backed by optional pinned addresses for the
+* case where DNS never answered.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <string.h>
+
+/* lwIP header files */
+#include "lwip/dns.h"
+#include "lwip/ip_addr.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+
+/* FreeRTOS header file */
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include <timers.h>
+
+#include "app_nvm.h"
+#include "dns_cache.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Bump when the layout of dns_cache_record_t changes */
+#define DNS_CACHE_VERSION                   (1u)
+
+/* Longest textual address accepted in the pinned address list */
+#define DNS_CACHE_MAX_ADDR_STR_LEN          (IP6ADDR_STRLEN_MAX)
+
+/* Address families handled by the cache */
+#define DNS_CACHE_FAMILY_V4                 (0u)
+#define DNS_CACHE_FAMILY_V6                 (1u)
+#define DNS_CACHE_NUM_FAMILIES              (2u)
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* Persisted addresses of the broker */
+typedef struct
+{
+    uint32_t version;
+    uint32_t host_crc;
+    uint32_t addr[DNS_CACHE_NUM_FAMILIES][4];   /* Network byte order; only addr[V4][0] used for IPv4 */
+    uint8_t valid[DNS_CACHE_NUM_FAMILIES];
+    uint8_t reserved[2];
+} dns_cache_record_t;
+
+/* Cache state; owned by the TCP/IP thread once started */
+typedef struct
+{
+    const char *hostname;
+    dns_cache_record_t record;
+    ip_addr_t stale[DNS_CACHE_NUM_FAMILIES];     /* Addresses to fall back to, cached or pinned */
+    bool has_stale[DNS_CACHE_NUM_FAMILIES];
+    ip_addr_t installed[DNS_CACHE_NUM_FAMILIES]; /* Addresses in the local host list */
+    bool is_installed[DNS_CACHE_NUM_FAMILIES];
+    bool fresh[DNS_CACHE_NUM_FAMILIES];
+    uint32_t pending;
+    TickType_t refresh_start;
+    SemaphoreHandle_t first_answer;
+} dns_cache_t;
+
+/*******************************************************************************
+* Forward declaration
+********************************************************************************/
+static void dns_cache_refresh(void *arg);
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static dns_cache_t dns_cache;
+
+/*******************************************************************************
+ * Function Name: dns_cache_addr_from_record
+ *******************************************************************************
+ * Summary:
+ *  Converts a persisted address to an lwIP address.
+ *
+ *******************************************************************************/
+static void dns_cache_addr_from_record(const dns_cache_record_t *record, uint32_t family, ip_addr_t *addr)
+{
+    if (family == DNS_CACHE_FAMILY_V4)
+    {
+        ip_addr_set_ip4_u32(addr, record->addr[family][0]);
+    }
+    else
+    {
+        IP_ADDR6(addr, record->addr[family][0], record->addr[family][1],
+                 record->addr[family][2], record->addr[family][3]);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: dns_cache_install
+ *******************************************************************************
+ * Summary:
+ *  Makes addr the local host list entry of its family. Runs in the TCP/IP
+ *  thread.
+ *
+ *******************************************************************************/
+static void dns_cache_install(uint32_t family, const ip_addr_t *addr)
+{
+    if (dns_cache.is_installed[family])
+    {
+        if (ip_addr_cmp(&dns_cache.installed[family], addr))
+        {
+            return;
+        }
+        (void)dns_local_removehost(dns_cache.hostname, &dns_cache.installed[family]);
+        dns_cache.is_installed[family] = false;
+    }
+
+    if (dns_local_addhost(dns_cache.hostname, addr) == ERR_OK)
+    {
+        ip_addr_copy(dns_cache.installed[family], *addr);
+        dns_cache.is_installed[family] = true;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: dns_cache_install_stale
+ *******************************************************************************
+ * Summary:
+ *  Installs the cached or pinned address of every family that got no fresh
+ *  answer, and releases a caller waiting for the first address. Runs in the
+ *  TCP/IP thread.
+ *
+ *******************************************************************************/
+static void dns_cache_install_stale(void)
+{
+    for (uint32_t family = 0; family < DNS_CACHE_NUM_FAMILIES; family++)
+    {
+        if (!dns_cache.fresh[family] && dns_cache.has_stale[family])
+        {
+            dns_cache_install(family, &dns_cache.stale[family]);
+        }
+    }
+
+    xSemaphoreGive(dns_cache.first_answer);
+}
+
+/*******************************************************************************
+ * Function Name: dns_cache_persist
+ *******************************************************************************
+ * Summary:
+ *  Saves the current addresses. Deferred to the timer task so that the flash
+ *  write does not stall the TCP/IP thread.
+ *
+ *******************************************************************************/
+static void dns_cache_persist(void *arg, uint32_t unused)
+{
+    dns_cache_record_t record;
+
+    (void)arg;
+    (void)unused;
+
+    LOCK_TCPIP_CORE();
+    memcpy(&record, &dns_cache.record, sizeof(record));
+    UNLOCK_TCPIP_CORE();
+
+    (void)app_nvm_write(APP_NVM_ID_DNS_CACHE, &record, sizeof(record));
+}
+
+/*******************************************************************************
+ * Function Name: dns_cache_timeout
+ *******************************************************************************
+ * Summary:
+ *  lwIP timeout handler: the resolver did not answer in time, so the cached or
+ *  pinned addresses are used until it does.
+ *
+ *******************************************************************************/
+static void dns_cache_timeout(void *arg)
+{
+    (void)arg;
+    dns_cache_install_stale();
+}
+
+/*******************************************************************************
+ * Function Name: dns_cache_found
+ *******************************************************************************
+ * Summary:
+ *  lwIP DNS callback of the A and AAAA queries. The first answer releases the
+ *  caller; every answer replaces the address of its family. Runs in the
+ *  TCP/IP thread.
+ *
+ *******************************************************************************/
+static void dns_cache_found(const char *name, const ip_addr_t *ipaddr, void *arg)
+{
+    uint32_t family = (uint32_t)arg;
+    bool refreshed = false;
+
+    (void)name;
+
+    if ((ipaddr != NULL) && (IP_IS_V4(ipaddr) == (family == DNS_CACHE_FAMILY_V4)))
+    {
+        if (family == DNS_CACHE_FAMILY_V4)
+        {
+            dns_cache.record.addr[family][0] = ip4_addr_get_u32(ip_2_ip4(ipaddr));
+        }
+        else
+        {
+            memcpy(dns_cache.record.addr[family], ip_2_ip6(ipaddr)->addr, sizeof(dns_cache.record.addr[family]));
+        }
+        dns_cache.record.valid[family] = 1u;
+        dns_cache.fresh[family] = true;
+        ip_addr_copy(dns_cache.stale[family], *ipaddr);
+        dns_cache.has_stale[family] = true;
+
+        dns_cache_install(family, ipaddr);
+
+        printf("Resolved %s to %s in %lu ms\n", dns_cache.hostname, ipaddr_ntoa(ipaddr),
+               (unsigned long)((xTaskGetTickCount() - dns_cache.refresh_start) * portTICK_PERIOD_MS));
+
+        sys_untimeout(dns_cache_timeout, NULL);
+        xSemaphoreGive(dns_cache.first_answer);
+        (void)xTimerPendFunctionCall(dns_cache_persist, NULL, 0, 0);
+    }
+
+    if ((dns_cache.pending > 0u) && (--dns_cache.pending == 0u))
+    {
+        refreshed = dns_cache.fresh[DNS_CACHE_FAMILY_V4] || dns_cache.fresh[DNS_CACHE_FAMILY_V6];
+        if (!refreshed)
+        {
+            sys_untimeout(dns_cache_timeout, NULL);
+            dns_cache_install_stale();
+        }
+        sys_timeout((refreshed ? DNS_CACHE_TTL_SECS : DNS_CACHE_RETRY_SECS) * 1000u, dns_cache_refresh, NULL);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: dns_cache_refresh
+ *******************************************************************************
+ * Summary:
+ *  Resolves the broker again by racing an A and an AAAA query. The local host
+ *  list entries are removed first, otherwise lwIP would answer the queries from
+ *  them. Runs in the TCP/IP thread.
+ *
+ *******************************************************************************/
+static void dns_cache_refresh(void *arg)
+{
+    static const u8_t addrtype[DNS_CACHE_NUM_FAMILIES] = { LWIP_DNS_ADDRTYPE_IPV4, LWIP_DNS_ADDRTYPE_IPV6 };
+    ip_addr_t addr;
+    err_t err;
+
+    (void)arg;
+
+    (void)dns_local_removehost(dns_cache.hostname, NULL);
+    memset(dns_cache.is_installed, 0, sizeof(dns_cache.is_installed));
+    memset(dns_cache.fresh, 0, sizeof(dns_cache.fresh));
+    dns_cache.pending = DNS_CACHE_NUM_FAMILIES;
+    dns_cache.refresh_start = xTaskGetTickCount();
+
+    sys_timeout(DNS_CACHE_RESOLVE_TIMEOUT_MS, dns_cache_timeout, NULL);
+
+    for (uint32_t family = 0; family < DNS_CACHE_NUM_FAMILIES; family++)
+    {
+        err = dns_gethostbyname_addrtype(dns_cache.hostname, &addr, dns_cache_found,
+                                         (void *)family, addrtype[family]);
+        if (err == ERR_OK)
+        {
+            /* Answered from lwIP's own cache */
+            dns_cache_found(dns_cache.hostname, &addr, (void *)family);
+        }
+        else if (err != ERR_INPROGRESS)
+        {
+            dns_cache_found(dns_cache.hostname, NULL, (void *)family);
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: dns_cache_add_pinned
+ *******************************************************************************
+ * Summary:
+ *  Parses the comma separated list of pinned addresses and keeps the first one
+ *  of each family for families without a cached address.
+ *
+ *******************************************************************************/
+static void dns_cache_add_pinned(const char *fallback_addrs)
+{
+    char addr_str[DNS_CACHE_MAX_ADDR_STR_LEN];
+    const char *next;
+    size_t len;
+    ip_addr_t addr;
+    uint32_t family;
+
+    while ((fallback_addrs != NULL) && (*fallback_addrs != '\0'))
+    {
+        next = strchr(fallback_addrs, ',');
+        len = (next != NULL) ? (size_t)(next - fallback_addrs) : strlen(fallback_addrs);
+
+        if ((len > 0u) && (len < sizeof(addr_str)))
+        {
+            memcpy(addr_str, fallback_addrs, len);
+            addr_str[len] = '\0';
+
+            if (ipaddr_aton(addr_str, &addr))
+            {
+                family = IP_IS_V4(&addr) ? DNS_CACHE_FAMILY_V4 : DNS_CACHE_FAMILY_V6;
+                if (!dns_cache.has_stale[family])
+                {
+                    ip_addr_copy(dns_cache.stale[family], addr);
+                    dns_cache.has_stale[family] = true;
+                }
+            }
+            else
+            {
+                printf("Ignoring invalid pinned broker address '%s'\n", addr_str);
+            }
+        }
+
+        fallback_addrs = (next != NULL) ? (next + 1) : NULL;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: dns_cache_start
+ *******************************************************************************
+ * Summary:
+ *  Starts caching the addresses of hostname. Loads the addresses saved by the
+ *  previous boot, adds the pinned addresses, and resolves the host. Returns
+ *  when the first address is installed, or after DNS_CACHE_RESOLVE_TIMEOUT_MS
+ *  with the saved or pinned addresses installed. Must be called once the
+ *  network is up.
+ *
+ * Parameters:
+ *  const char *hostname       : Host to cache; must stay valid
+ *  const char *fallback_addrs : Comma separated pinned IPv4/IPv6 addresses
+ *                               used when no address was ever resolved, or NULL
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS or an error code
+ *
+ *******************************************************************************/
+cy_rslt_t dns_cache_start(const char *hostname, const char *fallback_addrs)
+{
+    dns_cache_record_t record;
+    cy_rslt_t result;
+
+    if ((hostname == NULL) || (dns_cache.first_answer != NULL))
+    {
+        return DNS_CACHE_RSLT_ERR_BAD_ARG;
+    }
+
+    result = app_nvm_init();
+    if (result != CY_RSLT_SUCCESS)
+    {
+        return result;
+    }
+
+    dns_cache.first_answer = xSemaphoreCreateBinary();
+    if (dns_cache.first_answer == NULL)
+    {
+        return DNS_CACHE_RSLT_ERR_NOMEM;
+    }
+
+    dns_cache.hostname = hostname;
+    dns_cache.record.version = DNS_CACHE_VERSION;
+    dns_cache.record.host_crc = app_nvm_crc32(hostname, strlen(hostname));
+
+    if ((app_nvm_read(APP_NVM_ID_DNS_CACHE, &record, sizeof(record)) == CY_RSLT_SUCCESS) &&
+        (record.version == DNS_CACHE_VERSION) && (record.host_crc == dns_cache.record.host_crc))
+    {
+        memcpy(&dns_cache.record, &record, sizeof(record));
+        for (uint32_t family = 0; family < DNS_CACHE_NUM_FAMILIES; family++)
+        {
+            if (record.valid[family] != 0u)
+            {
+                dns_cache_addr_from_record(&record, family, &dns_cache.stale[family]);
+                dns_cache.has_stale[family] = true;
+            }
+        }
+    }
+
+    dns_cache_add_pinned(fallback_addrs);
+
+    LOCK_TCPIP_CORE();
+    dns_cache_refresh(NULL);
+    UNLOCK_TCPIP_CORE();
+
+    /* Both the resolver answer and the resolve timeout release the caller */
+    (void)xSemaphoreTake(dns_cache.first_answer, pdMS_TO_TICKS(DNS_CACHE_RESOLVE_TIMEOUT_MS * 2u));
+
+    return CY_RSLT_SUCCESS;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,75 @@
+/******************************************************************************
+* File Name: dns_cache.h
+*
+* Description: This file contains declarations of the functions of the broker
+* address cache, which keeps the MQTT broker resolvable across reboots and DNS
+* outages.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_DNS_CACHE_H_
+#define SOURCE_DNS_CACHE_H_
+
+#include "cy_result.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Result codes */
+#define DNS_CACHE_RSLT_MODULE               (CY_RSLT_MODULE_MIDDLEWARE_BASE + 0xF1u)
+#define DNS_CACHE_RSLT_ERR_BAD_ARG          CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, DNS_CACHE_RSLT_MODULE, 1)
+#define DNS_CACHE_RSLT_ERR_NOMEM            CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, DNS_CACHE_RSLT_MODULE, 2)
+
+/* Lifetime of a resolved address before it is resolved again. lwIP does not
+ * report the TTL of the DNS records it resolves, so the cache uses this value;
+ * lwIP's own resolver cache still honours the record TTL underneath. */
+#ifndef DNS_CACHE_TTL_SECS
+#define DNS_CACHE_TTL_SECS                  (60u * 60u)
+#endif
+
+/* Delay before retrying a refresh that got no answer */
+#ifndef DNS_CACHE_RETRY_SECS
+#define DNS_CACHE_RETRY_SECS                (60u)
+#endif
+
+/* Time the resolver gets before the cached or pinned addresses are used */
+#ifndef DNS_CACHE_RESOLVE_TIMEOUT_MS
+#define DNS_CACHE_RESOLVE_TIMEOUT_MS        (1500u)
+#endif
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t dns_cache_start(const char *hostname, const char *fallback_addrs);
+
+#endif /* SOURCE_DNS_CACHE_H_ */
@@ -0,0 +1,281 @@
+/******************************************************************************
+* File Name: ecc_bench.c
+*
+* Description: This file contains the ECC benchmark. It times the P-256
+* operations of a TLS handshake with the DWT cycle counter: the ECDHE key
+* generation and shared secret of the key exchange, and the ECDSA signature of
+* the client certificate and verification of the server. The heap held by the
+* curve, mostly the precomputed tables, is reported too. The output is parsed
+* by scripts/tls_profile_bench.py.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <malloc.h>
+#include <stdlib.h>
+
+/* mbedTLS header files */
+#include "mbedtls/ecdh.h"
+#include "mbedtls/ecdsa.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/platform.h"
+
+#include "ecc_bench.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#if defined(OTA_TLS_PROFILE_SIZE)
+#define ECC_BENCH_PROFILE                   "SIZE"
+#elif defined(OTA_TLS_PROFILE_SPEED)
+#define ECC_BENCH_PROFILE                   "SPEED"
+#else
+#define ECC_BENCH_PROFILE                   "DEFAULT"
+#endif
+
+/* Operations that are timed */
+#define ECC_BENCH_OP_KEYGEN                 (0u)
+#define ECC_BENCH_OP_SHARED                 (1u)
+#define ECC_BENCH_OP_SIGN                   (2u)
+#define ECC_BENCH_OP_VERIFY                 (3u)
+#define ECC_BENCH_NUM_OPS                   (4u)
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+typedef struct
+{
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} ecc_bench_stat_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static const char * const ecc_bench_op_names[ECC_BENCH_NUM_OPS] =
+{
+    "ecdhe_keygen", "ecdhe_shared", "ecdsa_sign", "ecdsa_verify"
+};
+
+/* Heap held by mbedTLS while the benchmark runs, and its peak */
+static uint32_t ecc_bench_heap_held;
+static uint32_t ecc_bench_heap_peak;
+
+/*******************************************************************************
+ * Function Name: ecc_bench_calloc
+ *******************************************************************************
+ * Summary:
+ *  Allocator of mbedTLS during the benchmark. Counts the size of every block,
+ *  so the peak includes the buffers an operation frees before it returns.
+ *
+ *******************************************************************************/
+static void *ecc_bench_calloc(size_t count, size_t size)
+{
+    void *ptr = calloc(count, size);
+
+    if (ptr != NULL)
+    {
+        ecc_bench_heap_held += (uint32_t)malloc_usable_size(ptr);
+        if (ecc_bench_heap_held > ecc_bench_heap_peak)
+        {
+            ecc_bench_heap_peak = ecc_bench_heap_held;
+        }
+    }
+    return ptr;
+}
+
+/*******************************************************************************
+ * Function Name: ecc_bench_free
+ *******************************************************************************
+ * Summary:
+ *  Releases a block of ecc_bench_calloc(). The blocks come from calloc(), so
+ *  blocks allocated before or after the benchmark are freed the same way.
+ *
+ *******************************************************************************/
+static void ecc_bench_free(void *ptr)
+{
+    if (ptr != NULL)
+    {
+        ecc_bench_heap_held -= (uint32_t)malloc_usable_size(ptr);
+    }
+    free(ptr);
+}
+
+/*******************************************************************************
+ * Function Name: ecc_bench_record
+ *******************************************************************************
+ * Summary:
+ *  Adds one sample to the statistics of an operation.
+ *
+ *******************************************************************************/
+static void ecc_bench_record(ecc_bench_stat_t *stat, uint32_t cycles)
+{
+    stat->min = (cycles < stat->min) ? cycles : stat->min;
+    stat->max = (cycles > stat->max) ? cycles : stat->max;
+    stat->total += cycles;
+}
+
+/*******************************************************************************
+ * Function Name: ecc_bench_run
+ *******************************************************************************
+ * Summary:
+ *  Runs every operation ECC_BENCH_ITERATIONS times and prints the cycles and
+ *  the peak heap of mbedTLS, from the seeding of the random generator on. It
+ *  runs before the network starts, so no other mbedTLS user is counted. The
+ *  first run of the fixed-base operations includes building
+ *  the comb table when the SPEED profile is selected, so the maximum shows the
+ *  first-handshake cost and the minimum the cost of the later ones.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void ecc_bench_run(void)
+{
+    static const unsigned char hash[32] = { 0x5a };
+    ecc_bench_stat_t stats[ECC_BENCH_NUM_OPS];
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_ecp_group grp;
+    mbedtls_mpi d, peer_d, z, r, s;
+    mbedtls_ecp_point q, peer_q;
+    uint32_t start;
+    int ret;
+
+    for (uint32_t op = 0; op < ECC_BENCH_NUM_OPS; op++)
+    {
+        stats[op].min = UINT32_MAX;
+        stats[op].max = 0u;
+        stats[op].total = 0u;
+    }
+
+    /* Cycle counter; left running if another user started it, as every
+     * measurement is a wrapping difference */
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0u)
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_mpi_init(&d);
+    mbedtls_mpi_init(&peer_d);
+    mbedtls_mpi_init(&z);
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+    mbedtls_ecp_point_init(&q);
+    mbedtls_ecp_point_init(&peer_q);
+
+    ecc_bench_heap_held = 0u;
+    ecc_bench_heap_peak = 0u;
+    mbedtls_platform_set_calloc_free(ecc_bench_calloc, ecc_bench_free);
+
+    ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, NULL, 0);
+    if (ret == 0)
+    {
+        ret = mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256R1);
+    }
+    if (ret == 0)
+    {
+        /* Key of the other side of the exchange */
+        ret = mbedtls_ecdh_gen_public(&grp, &peer_d, &peer_q, mbedtls_ctr_drbg_random, &drbg);
+    }
+
+    for (uint32_t i = 0; (i < ECC_BENCH_ITERATIONS) && (ret == 0); i++)
+    {
+        start = DWT->CYCCNT;
+        ret = mbedtls_ecdh_gen_public(&grp, &d, &q, mbedtls_ctr_drbg_random, &drbg);
+        ecc_bench_record(&stats[ECC_BENCH_OP_KEYGEN], DWT->CYCCNT - start);
+
+        if (ret == 0)
+        {
+            start = DWT->CYCCNT;
+            ret = mbedtls_ecdh_compute_shared(&grp, &z, &peer_q, &d, mbedtls_ctr_drbg_random, &drbg);
+            ecc_bench_record(&stats[ECC_BENCH_OP_SHARED], DWT->CYCCNT - start);
+        }
+        if (ret == 0)
+        {
+            start = DWT->CYCCNT;
+            ret = mbedtls_ecdsa_sign(&grp, &r, &s, &d, hash, sizeof(hash), mbedtls_ctr_drbg_random, &drbg);
+            ecc_bench_record(&stats[ECC_BENCH_OP_SIGN], DWT->CYCCNT - start);
+        }
+        if (ret == 0)
+        {
+            start = DWT->CYCCNT;
+            ret = mbedtls_ecdsa_verify(&grp, hash, sizeof(hash), &q, &r, &s);
+            ecc_bench_record(&stats[ECC_BENCH_OP_VERIFY], DWT->CYCCNT - start);
+        }
+    }
+
+    if (ret != 0)
+    {
+        printf("ECC bench [%s] failed: -0x%04x\n", ECC_BENCH_PROFILE, (unsigned int)-ret);
+    }
+    else
+    {
+        for (uint32_t op = 0; op < ECC_BENCH_NUM_OPS; op++)
+        {
+            printf("ECC bench [%s] %s: min %lu max %lu avg %lu cycles (%lu ms)\n",
+                   ECC_BENCH_PROFILE, ecc_bench_op_names[op],
+                   (unsigned long)stats[op].min, (unsigned long)stats[op].max,
+                   (unsigned long)(stats[op].total / ECC_BENCH_ITERATIONS),
+                   (unsigned long)((stats[op].total / ECC_BENCH_ITERATIONS) / (SystemCoreClock / 1000u)));
+        }
+        printf("ECC bench [%s] heap: %lu bytes peak, %lu bytes held, window %d, comb tables %d\n",
+               ECC_BENCH_PROFILE, (unsigned long)ecc_bench_heap_peak, (unsigned long)ecc_bench_heap_held,
+               MBEDTLS_ECP_WINDOW_SIZE, MBEDTLS_ECP_FIXED_POINT_OPTIM);
+    }
+
+    mbedtls_ecp_point_free(&peer_q);
+    mbedtls_ecp_point_free(&q);
+    mbedtls_mpi_free(&s);
+    mbedtls_mpi_free(&r);
+    mbedtls_mpi_free(&z);
+    mbedtls_mpi_free(&peer_d);
+    mbedtls_mpi_free(&d);
+    mbedtls_ecp_group_free(&grp);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+    mbedtls_platform_set_calloc_free(calloc, free);
+
+    printf("ECC bench done\n");
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,526 @@
+/******************************************************************************
+* File Name: heap_trace.c
+*
+* Description: This file contains the heap allocation tracer. The GNU linker
+* wraps malloc(), calloc(), realloc(), free(), pvPortMalloc() and vPortFree(),
+* and Iot_DefaultMalloc maps to heap_trace_iot_malloc(). Every allocation and
+* release is logged with its size, caller and time to a ring, which a low
+* priority task prints on the debug UART as lines of four hex words:
+*
+*   HT <time_ms> <kind << 24 | size> <pointer> <caller>
+*
+* A failed allocation prints the pending records right away, before the
+* malloc failed hook of FreeRTOS runs. scripts/heap_timeline.py rebuilds the
+* live heap over time and its owners at the peak from the serial log.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <stdlib.h>
+
+/* FreeRTOS header files */
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "iot_pool.h"
+#include "rtos_stats.h"
+#include "heap_trace.h"
+
+#if defined(HEAP_TRACE)
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define HEAP_TRACE_TASK_STACK_SIZE          (512)
+#define HEAP_TRACE_TASK_PRIORITY            (tskIDLE_PRIORITY + 1)
+
+/* Interval at which the ring is printed */
+#define HEAP_TRACE_POLL_MS                  (20u)
+
+/* Record kinds, in the top byte of the size word */
+#define HEAP_TRACE_KIND_MALLOC              ('M')
+#define HEAP_TRACE_KIND_CALLOC              ('C')
+#define HEAP_TRACE_KIND_REALLOC             ('R')
+#define HEAP_TRACE_KIND_PORT                ('P')   /* pvPortMalloc() */
+#define HEAP_TRACE_KIND_IOT                 ('I')   /* Iot_DefaultMalloc from the heap */
+#define HEAP_TRACE_KIND_POOL                ('B')   /* Iot_DefaultMalloc from a pool block */
+#define HEAP_TRACE_KIND_FREE                ('F')
+#define HEAP_TRACE_KIND_FAILED              ('X')
+
+#define HEAP_TRACE_SIZE_MASK                (0x00FFFFFFu)
+
+/* "HT" and four words of eight hex digits, each after a space */
+#define HEAP_TRACE_LINE_LEN                 (2u + (4u * 9u))
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+typedef struct
+{
+    uint32_t time_ms;
+    uint32_t size_kind;
+    uint32_t ptr;
+    uint32_t caller;
+} heap_trace_record_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+void *__real_pvPortMalloc(size_t size);
+void __real_vPortFree(void *ptr);
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Free-running indices of the ring; written inside critical sections */
+static heap_trace_record_t heap_trace_ring[HEAP_TRACE_RING_SIZE];
+static volatile uint32_t heap_trace_head;
+static volatile uint32_t heap_trace_tail;
+static volatile uint32_t heap_trace_dropped;
+
+/* Set while pvPortMalloc() or Iot_DefaultMalloc runs, with the scheduler
+ * suspended, so their inner heap calls are not recorded twice */
+static bool heap_trace_nested;
+static bool heap_trace_nested_failed;
+static void *heap_trace_nested_caller;
+
+/*******************************************************************************
+ * Function Name: heap_trace_record
+ *******************************************************************************
+ * Summary:
+ *  Appends a record to the ring, or counts it as dropped when the ring is
+ *  full. Safe from tasks and interrupts, before the scheduler starts too.
+ *
+ *******************************************************************************/
+static void heap_trace_record(uint8_t kind, const void *ptr, size_t size, const void *caller)
+{
+    heap_trace_record_t *record;
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+    if ((heap_trace_head - heap_trace_tail) >= HEAP_TRACE_RING_SIZE)
+    {
+        heap_trace_dropped++;
+    }
+    else
+    {
+        record = &heap_trace_ring[heap_trace_head % HEAP_TRACE_RING_SIZE];
+        record->time_ms = (uint32_t)(xTaskGetTickCountFromISR() * portTICK_PERIOD_MS);
+        record->size_kind = ((uint32_t)kind << 24) | ((uint32_t)size & HEAP_TRACE_SIZE_MASK);
+        record->ptr = (uint32_t)ptr;
+        record->caller = (uint32_t)caller;
+        heap_trace_head++;
+    }
+
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_pop
+ *******************************************************************************
+ * Summary:
+ *  Removes the oldest record from the ring.
+ *
+ * Return:
+ *  bool : false when the ring is empty
+ *
+ *******************************************************************************/
+static bool heap_trace_pop(heap_trace_record_t *record)
+{
+    bool found = false;
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+
+    if (heap_trace_tail != heap_trace_head)
+    {
+        *record = heap_trace_ring[heap_trace_tail % HEAP_TRACE_RING_SIZE];
+        heap_trace_tail++;
+        found = true;
+    }
+
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    return found;
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_format
+ *******************************************************************************
+ * Summary:
+ *  Formats a record as an output line without the C library, which may
+ *  allocate itself.
+ *
+ *******************************************************************************/
+static void heap_trace_format(const heap_trace_record_t *record, char line[HEAP_TRACE_LINE_LEN + 2u])
+{
+    static const char hex[] = "0123456789abcdef";
+    const uint32_t words[4] = { record->time_ms, record->size_kind, record->ptr, record->caller };
+    char *p = line;
+
+    *p++ = 'H';
+    *p++ = 'T';
+    for (uint32_t i = 0; i < 4u; i++)
+    {
+        *p++ = ' ';
+        for (int32_t shift = 28; shift >= 0; shift -= 4)
+        {
+            *p++ = hex[(words[i] >> shift) & 0xFu];
+        }
+    }
+    *p++ = '\n';
+    *p = '\0';
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_flush_blocking
+ *******************************************************************************
+ * Summary:
+ *  Writes the pending records straight to the debug UART. Used when an
+ *  allocation fails, as the malloc failed hook may never return and the
+ *  output task cannot run while the scheduler is suspended.
+ *
+ *******************************************************************************/
+static void heap_trace_flush_blocking(void)
+{
+    heap_trace_record_t record;
+    char line[HEAP_TRACE_LINE_LEN + 2u];
+
+    while (heap_trace_pop(&record))
+    {
+        heap_trace_format(&record, line);
+        for (const char *p = line; *p != '\0'; p++)
+        {
+            (void)cyhal_uart_putc(&cy_retarget_io_uart_obj, (uint32_t)*p);
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_alloc
+ *******************************************************************************
+ * Summary:
+ *  Records the result of an allocation. Inner heap calls of a traced outer
+ *  allocator are skipped, except failures: those are recorded against the
+ *  outer caller and flushed at once, since the malloc failed hook runs before
+ *  the outer allocator returns.
+ *
+ *******************************************************************************/
+static void heap_trace_alloc(uint8_t kind, const void *ptr, size_t size, const void *caller)
+{
+    if ((ptr == NULL) && (size > 0u))
+    {
+        if (heap_trace_nested)
+        {
+            heap_trace_nested_failed = true;
+            caller = heap_trace_nested_caller;
+        }
+        heap_trace_record(HEAP_TRACE_KIND_FAILED, NULL, size, caller);
+        heap_trace_flush_blocking();
+    }
+    else if ((ptr != NULL) && !heap_trace_nested)
+    {
+        heap_trace_record(kind, ptr, size, caller);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_free
+ *******************************************************************************
+ * Summary:
+ *  Records a release, unless it is the inner call of a traced outer allocator.
+ *
+ *******************************************************************************/
+static void heap_trace_free(const void *ptr, const void *caller)
+{
+    if ((ptr != NULL) && !heap_trace_nested)
+    {
+        heap_trace_record(HEAP_TRACE_KIND_FREE, ptr, 0u, caller);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_nest_begin
+ *******************************************************************************
+ * Summary:
+ *  Enters an outer allocator. The scheduler stays suspended until
+ *  heap_trace_nest_end(), as heap_3 does around malloc() anyway.
+ *
+ *******************************************************************************/
+static void heap_trace_nest_begin(void *caller)
+{
+    vTaskSuspendAll();
+    heap_trace_nested = true;
+    heap_trace_nested_failed = false;
+    heap_trace_nested_caller = caller;
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_nest_end
+ *******************************************************************************
+ * Summary:
+ *  Leaves an outer allocator and records its result, unless an inner failure
+ *  was recorded already.
+ *
+ *******************************************************************************/
+static void heap_trace_nest_end(uint8_t kind, const void *ptr, size_t size, const void *caller)
+{
+    heap_trace_nested = false;
+    if (!heap_trace_nested_failed)
+    {
+        heap_trace_alloc(kind, ptr, size, caller);
+    }
+    (void)xTaskResumeAll();
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_malloc
+ *******************************************************************************
+ * Summary:
+ *  Replaces malloc() at link time.
+ *
+ *******************************************************************************/
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+
+    heap_trace_alloc(HEAP_TRACE_KIND_MALLOC, ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_calloc
+ *******************************************************************************
+ * Summary:
+ *  Replaces calloc() at link time; mbedTLS allocates through it. A request
+ *  whose size overflows fails in calloc(), and is recorded as a failure with
+ *  the largest size a record holds instead of the wrapped product.
+ *
+ *******************************************************************************/
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *ptr = __real_calloc(count, size);
+    size_t total;
+
+    if (__builtin_mul_overflow(count, size, &total))
+    {
+        total = SIZE_MAX;
+    }
+
+    heap_trace_alloc(HEAP_TRACE_KIND_CALLOC, ptr, total, __builtin_return_address(0));
+    return ptr;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_realloc
+ *******************************************************************************
+ * Summary:
+ *  Replaces realloc() at link time. A move is recorded as the release of the
+ *  old block and the allocation of the new one.
+ *
+ *******************************************************************************/
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    void *caller = __builtin_return_address(0);
+    void *new_ptr = __real_realloc(ptr, size);
+
+    if ((new_ptr != NULL) || (size == 0u))
+    {
+        heap_trace_free(ptr, caller);
+    }
+    heap_trace_alloc(HEAP_TRACE_KIND_REALLOC, new_ptr, size, caller);
+    return new_ptr;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_free
+ *******************************************************************************
+ * Summary:
+ *  Replaces free() at link time.
+ *
+ *******************************************************************************/
+void __wrap_free(void *ptr)
+{
+    heap_trace_free(ptr, __builtin_return_address(0));
+    __real_free(ptr);
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_pvPortMalloc
+ *******************************************************************************
+ * Summary:
+ *  Replaces pvPortMalloc() at link time; FreeRTOS objects and the libraries
+ *  built on abstraction-rtos allocate through it.
+ *
+ *******************************************************************************/
+void *__wrap_pvPortMalloc(size_t size)
+{
+    void *caller = __builtin_return_address(0);
+    void *ptr;
+
+    heap_trace_nest_begin(caller);
+    ptr = __real_pvPortMalloc(size);
+    heap_trace_nest_end(HEAP_TRACE_KIND_PORT, ptr, size, caller);
+    return ptr;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_vPortFree
+ *******************************************************************************
+ * Summary:
+ *  Replaces vPortFree() at link time.
+ *
+ *******************************************************************************/
+void __wrap_vPortFree(void *ptr)
+{
+    heap_trace_free(ptr, __builtin_return_address(0));
+    vTaskSuspendAll();
+    heap_trace_nested = true;
+    __real_vPortFree(ptr);
+    heap_trace_nested = false;
+    (void)xTaskResumeAll();
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_iot_malloc
+ *******************************************************************************
+ * Summary:
+ *  Iot_DefaultMalloc of the IoT SDK while tracing. Allocates from the pools
+ *  when IOT_POOL_ALLOCATOR is set, else from the heap.
+ *
+ *******************************************************************************/
+void *heap_trace_iot_malloc(size_t size)
+{
+    void *caller = __builtin_return_address(0);
+    void *ptr;
+    uint8_t kind = HEAP_TRACE_KIND_IOT;
+
+    heap_trace_nest_begin(caller);
+#if defined(IOT_POOL_ALLOCATOR)
+    ptr = iot_pool_malloc(size);
+    if (iot_pool_owns(ptr))
+    {
+        kind = HEAP_TRACE_KIND_POOL;
+    }
+#else
+    ptr = malloc(size);
+#endif
+    heap_trace_nest_end(kind, ptr, size, caller);
+    return ptr;
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_iot_free
+ *******************************************************************************
+ * Summary:
+ *  Iot_DefaultFree of the IoT SDK while tracing.
+ *
+ *******************************************************************************/
+void heap_trace_iot_free(void *ptr)
+{
+    heap_trace_free(ptr, __builtin_return_address(0));
+    vTaskSuspendAll();
+    heap_trace_nested = true;
+#if defined(IOT_POOL_ALLOCATOR)
+    iot_pool_free(ptr);
+#else
+    free(ptr);
+#endif
+    heap_trace_nested = false;
+    (void)xTaskResumeAll();
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_task
+ *******************************************************************************
+ * Summary:
+ *  Prints the records of the ring, and the number of records dropped because
+ *  the UART could not keep up.
+ *
+ *******************************************************************************/
+static void heap_trace_task(void *args)
+{
+    heap_trace_record_t record;
+    char line[HEAP_TRACE_LINE_LEN + 2u];
+    uint32_t dropped = 0u;
+
+    (void)args;
+
+    printf("HT BOOT\n");
+    for (;;)
+    {
+        while (heap_trace_pop(&record))
+        {
+            heap_trace_format(&record, line);
+            printf("%s", line);
+        }
+
+        if (heap_trace_dropped != dropped)
+        {
+            dropped = heap_trace_dropped;
+            printf("HT DROP %lu\n", (unsigned long)dropped);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(HEAP_TRACE_POLL_MS));
+    }
+}
+
+/*******************************************************************************
+ * Function Name: heap_trace_start
+ *******************************************************************************
+ * Summary:
+ *  Starts printing the trace. Allocations are recorded from reset on; the
+ *  ring holds those made until the task runs.
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS or HEAP_TRACE_RSLT_ERR_NOMEM
+ *
+ *******************************************************************************/
+cy_rslt_t heap_trace_start(void)
+{
+    rtos_stats_stack_register("HEAP TRACE", HEAP_TRACE_TASK_STACK_SIZE);
+    if (xTaskCreate(heap_trace_task, "HEAP TRACE", HEAP_TRACE_TASK_STACK_SIZE, NULL,
+                    HEAP_TRACE_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        return HEAP_TRACE_RSLT_ERR_NOMEM;
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+#endif /* HEAP_TRACE */
+
+/* [] END OF FILE */
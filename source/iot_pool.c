@@ -0,0 +1,356 @@
+/******************************************************************************
+* File Name: iot_pool.c
+*
+* Description: This file contains the size-class pool allocator of the IoT
+* SDK. MQTT packets, operations and taskpool jobs are short-lived and small;
+* serving them from fixed-size blocks keeps them from fragmenting the general
+* heap that mbedTLS and the OTA download depend on. Each class is a free list
+* of equal blocks in a static arena, so allocation and release are O(1).
+* Requests larger than the largest class, or made while their class is
+* exhausted, fall back to malloc().
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <stdlib.h>
+#include <unistd.h>
+#if defined(__GNUC__) && !defined(__ARMCC_VERSION)
+#include <malloc.h>
+#endif
+
+/* FreeRTOS header files */
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "iot_pool.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Number of size classes, see iot_pool_classes */
+#define IOT_POOL_CLASS_COUNT                (5u)
+
+/* Block alignment; block sizes are multiples of it */
+#define IOT_POOL_ALIGN                      (8u)
+
+/* Sum of the classes of iot_pool_classes; checked by iot_pool_init() */
+#define IOT_POOL_ARENA_SIZE                 ((32u * 16u) + (64u * 16u) + (128u * 16u) + (256u * 8u) + (512u * 4u))
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* Free block, linked through its first word */
+typedef struct iot_pool_block
+{
+    struct iot_pool_block *next;
+} iot_pool_block_t;
+
+/* Size class geometry */
+typedef struct
+{
+    uint16_t block_size;
+    uint16_t block_count;
+} iot_pool_geometry_t;
+
+/* Size class state and counters */
+typedef struct
+{
+    uint8_t *start;                     /* First block of the class */
+    uint8_t *end;                       /* One past the last block */
+    iot_pool_block_t *free_list;
+    uint32_t used;                      /* Blocks in use */
+    uint32_t peak;                      /* Most blocks in use at once */
+    uint32_t allocs;                    /* Successful allocations */
+    uint32_t exhausted;                 /* Requests sent to the heap because the class was full */
+    uint64_t requested;                 /* Bytes requested by all allocations */
+} iot_pool_class_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Block size and count of every class, smallest first. Tuned for the MQTT
+ * operations, packets and taskpool jobs of an OTA check. */
+static const iot_pool_geometry_t iot_pool_classes[IOT_POOL_CLASS_COUNT] =
+{
+    {  32u, 16u },
+    {  64u, 16u },
+    { 128u, 16u },
+    { 256u,  8u },
+    { 512u,  4u }
+};
+
+static CY_ALIGN(IOT_POOL_ALIGN) uint8_t iot_pool_arena[IOT_POOL_ARENA_SIZE];
+static iot_pool_class_t iot_pool_state[IOT_POOL_CLASS_COUNT];
+static bool iot_pool_ready;
+
+/* Requests larger than the largest class */
+static uint32_t iot_pool_oversize;
+
+/* The largest free block is found by walking the free list of newlib-nano,
+ * whose layout other C libraries do not share; they only report the free
+ * heap from mallinfo() */
+#if defined(__GNUC__) && !defined(__ARMCC_VERSION) && defined(_NANO_MALLOC) && !defined(__PICOLIBC__)
+#define IOT_POOL_HEAP_WALK
+#endif
+
+#if defined(IOT_POOL_HEAP_WALK)
+/* Free list of the newlib-nano allocator and the end of the heap region of
+ * the linker script, for the largest free block of the heap */
+typedef struct iot_pool_heap_chunk
+{
+    long size;
+    struct iot_pool_heap_chunk *next;
+} iot_pool_heap_chunk_t;
+
+extern iot_pool_heap_chunk_t *__malloc_free_list;
+extern uint8_t __HeapLimit;
+#endif
+
+/*******************************************************************************
+ * Function Name: iot_pool_init
+ *******************************************************************************
+ * Summary:
+ *  Carves the arena into the blocks of every class. Must be called before the
+ *  IoT SDK is initialized; allocations made before go to the heap.
+ *
+ *******************************************************************************/
+void iot_pool_init(void)
+{
+    uint8_t *block = iot_pool_arena;
+    iot_pool_class_t *pool;
+
+    for (uint32_t i = 0; i < IOT_POOL_CLASS_COUNT; i++)
+    {
+        pool = &iot_pool_state[i];
+        pool->start = block;
+        pool->free_list = NULL;
+
+        for (uint32_t j = 0; j < iot_pool_classes[i].block_count; j++)
+        {
+            ((iot_pool_block_t *)block)->next = pool->free_list;
+            pool->free_list = (iot_pool_block_t *)block;
+            block += iot_pool_classes[i].block_size;
+        }
+        pool->end = block;
+    }
+
+    CY_ASSERT(block == &iot_pool_arena[IOT_POOL_ARENA_SIZE]);
+    iot_pool_ready = true;
+}
+
+/*******************************************************************************
+ * Function Name: iot_pool_malloc
+ *******************************************************************************
+ * Summary:
+ *  Allocates memory for the IoT SDK through Iot_DefaultMalloc. Takes a block
+ *  of the smallest class that fits, or falls back to malloc().
+ *
+ * Parameters:
+ *  size_t size : Bytes to allocate
+ *
+ * Return:
+ *  void * : Memory, or NULL when neither the pools nor the heap can serve it
+ *
+ *******************************************************************************/
+void *iot_pool_malloc(size_t size)
+{
+    iot_pool_class_t *pool;
+    iot_pool_block_t *block;
+
+    if (iot_pool_ready)
+    {
+        for (uint32_t i = 0; i < IOT_POOL_CLASS_COUNT; i++)
+        {
+            if (size > iot_pool_classes[i].block_size)
+            {
+                continue;
+            }
+
+            pool = &iot_pool_state[i];
+            taskENTER_CRITICAL();
+            block = pool->free_list;
+            if (block != NULL)
+            {
+                pool->free_list = block->next;
+                pool->used++;
+                pool->allocs++;
+                pool->requested += size;
+                if (pool->used > pool->peak)
+                {
+                    pool->peak = pool->used;
+                }
+            }
+            else
+            {
+                pool->exhausted++;
+            }
+            taskEXIT_CRITICAL();
+
+            return (block != NULL) ? (void *)block : malloc(size);
+        }
+
+        taskENTER_CRITICAL();
+        iot_pool_oversize++;
+        taskEXIT_CRITICAL();
+    }
+
+    return malloc(size);
+}
+
+/*******************************************************************************
+ * Function Name: iot_pool_free
+ *******************************************************************************
+ * Summary:
+ *  Releases memory allocated by iot_pool_malloc() through Iot_DefaultFree.
+ *  The owning class is found from the address.
+ *
+ *******************************************************************************/
+void iot_pool_free(void *ptr)
+{
+    uint8_t *block = (uint8_t *)ptr;
+    iot_pool_class_t *pool;
+
+    if (!iot_pool_owns(ptr))
+    {
+        free(ptr);
+        return;
+    }
+
+    for (uint32_t i = 0; i < IOT_POOL_CLASS_COUNT; i++)
+    {
+        pool = &iot_pool_state[i];
+        if (block < pool->end)
+        {
+            taskENTER_CRITICAL();
+            ((iot_pool_block_t *)block)->next = pool->free_list;
+            pool->free_list = (iot_pool_block_t *)block;
+            pool->used--;
+            taskEXIT_CRITICAL();
+            return;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: iot_pool_owns
+ *******************************************************************************
+ * Summary:
+ *  Tells whether memory is a pool block rather than a heap allocation.
+ *
+ *******************************************************************************/
+bool iot_pool_owns(const void *ptr)
+{
+    const uint8_t *block = (const uint8_t *)ptr;
+
+    return (block >= iot_pool_arena) && (block < &iot_pool_arena[IOT_POOL_ARENA_SIZE]);
+}
+
+/*******************************************************************************
+ * Function Name: iot_pool_heap_report
+ *******************************************************************************
+ * Summary:
+ *  Prints the free heap and, with newlib-nano, its largest free block and
+ *  fragmentation.
+ *
+ *******************************************************************************/
+static void iot_pool_heap_report(void)
+{
+#if defined(IOT_POOL_HEAP_WALK)
+    uint32_t free_bytes;
+    uint32_t largest;
+
+    /* Unclaimed space above the break counts as one free block */
+    vTaskSuspendAll();
+    largest = (uint32_t)(&__HeapLimit - (uint8_t *)sbrk(0));
+    free_bytes = largest;
+    for (const iot_pool_heap_chunk_t *chunk = __malloc_free_list; chunk != NULL; chunk = chunk->next)
+    {
+        free_bytes += (uint32_t)chunk->size;
+        if ((uint32_t)chunk->size > largest)
+        {
+            largest = (uint32_t)chunk->size;
+        }
+    }
+    (void)xTaskResumeAll();
+
+    if (free_bytes > 0u)
+    {
+        printf("Heap: %lu bytes free, largest free block %lu, fragmentation %lu%%\n",
+               (unsigned long)free_bytes, (unsigned long)largest,
+               (unsigned long)(((free_bytes - largest) * 100u) / free_bytes));
+    }
+#elif defined(__GNUC__) && !defined(__ARMCC_VERSION)
+    /* Released blocks below the break only; the largest one is not known */
+    printf("Heap: %lu bytes free in released blocks\n", (unsigned long)mallinfo().fordblks);
+#endif
+}
+
+/*******************************************************************************
+ * Function Name: iot_pool_report
+ *******************************************************************************
+ * Summary:
+ *  Prints the counters of every class and the fragmentation of the heap: the
+ *  share of the free heap that is not part of the largest free block. The
+ *  waste column is the share of the allocated blocks not covered by the
+ *  requests, over all allocations of the class.
+ *
+ *******************************************************************************/
+void iot_pool_report(void)
+{
+    const iot_pool_class_t *pool;
+    uint64_t capacity;
+
+    if (iot_pool_ready)
+    {
+        printf("\nIoT pool:  SIZE  USED  PEAK  TOTAL   ALLOCS  EXHAUSTED  WASTE\n");
+        for (uint32_t i = 0; i < IOT_POOL_CLASS_COUNT; i++)
+        {
+            pool = &iot_pool_state[i];
+            capacity = (uint64_t)pool->allocs * iot_pool_classes[i].block_size;
+            printf("          %5u %5lu %5lu %6u %8lu %10lu %5lu%%\n",
+                   (unsigned int)iot_pool_classes[i].block_size,
+                   (unsigned long)pool->used, (unsigned long)pool->peak,
+                   (unsigned int)iot_pool_classes[i].block_count,
+                   (unsigned long)pool->allocs, (unsigned long)pool->exhausted,
+                   (unsigned long)((capacity > 0u) ? (((capacity - pool->requested) * 100u) / capacity) : 0u));
+        }
+        printf("IoT pool: %lu oversize allocations from the heap\n", (unsigned long)iot_pool_oversize);
+    }
+
+    iot_pool_heap_report();
+}
+
+/* [] END OF FILE */
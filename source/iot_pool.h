@@ -1,8 +1,8 @@
 /******************************************************************************
-* File Name: led_task.h
+* File Name: iot_pool.h
 *
-* Description: This file contains declaration of task and functions related to
-* the LED task.
+* Description: This file contains declarations of the size-class pool
+* allocator of the IoT SDK.
 *
 *******************************************************************************
 * (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
@@ -35,9 +35,20 @@
 * system or application assumes all risk of such use and in doing so agrees to
 * indemnify Cypress against all liability.
 *******************************************************************************/
-#ifndef SOURCE_LED_TASK_H_
-#define SOURCE_LED_TASK_H_
 
-void led_task(void *arg);
+#ifndef SOURCE_IOT_POOL_H_
+#define SOURCE_IOT_POOL_H_
 
-#endif /* SOURCE_LED_TASK_H_ */
+#include <stdbool.h>
+#include <stddef.h>
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void iot_pool_init(void);
+void *iot_pool_malloc(size_t size);
+void iot_pool_free(void *ptr);
+bool iot_pool_owns(const void *ptr);
+void iot_pool_report(void);
+
+#endif /* SOURCE_IOT_POOL_H_ */
@@ -0,0 +1,297 @@
+/******************************************************************************
+* File Name: jitter_probe.c
+*
+* Description: This file contains the wake-up jitter probe. A periodic task at
+* the priority of the application tasks measures how late it wakes up against
+* the tick it was due on, and keeps a histogram of the lateness for each OTA
+* phase: idle, download, TLS handshake and flash erase.
+* The phases are reported by the OTA callback, the TLS handshake hook of
+* ota_tls.c and a hook of flash_area_erase().
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+
+/* FreeRTOS header files */
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "rtos_stats.h"
+#include "jitter_probe.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define JITTER_PROBE_TASK_STACK_SIZE        (512)
+
+/* Number of histogram bins, see jitter_bin_limits_us */
+#define JITTER_BIN_COUNT                    (10u)
+
+/* Length of a tick */
+#define JITTER_TICK_US                      (portTICK_PERIOD_MS * 1000u)
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* Lateness statistics of a phase */
+typedef struct
+{
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t bins[JITTER_BIN_COUNT];
+} jitter_histogram_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+#if defined(JITTER_PROBE_HOOKS)
+struct flash_area;
+int __real_flash_area_erase(const struct flash_area *fa, uint32_t off, uint32_t len);
+#endif
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Upper limit of every bin but the last, in microseconds */
+static const uint32_t jitter_bin_limits_us[JITTER_BIN_COUNT - 1u] =
+{
+    10u, 20u, 50u, 100u, 200u, 500u, 1000u, 2000u, 5000u
+};
+
+static const char * const jitter_phase_names[JITTER_PHASE_MAX] =
+{
+    [JITTER_PHASE_IDLE] = "idle",
+    [JITTER_PHASE_DOWNLOAD] = "download",
+    [JITTER_PHASE_HANDSHAKE] = "TLS handshake",
+    [JITTER_PHASE_FLASH_ERASE] = "flash erase"
+};
+
+/* Phases in progress, set by the OTA code */
+static volatile bool jitter_phase_active[JITTER_PHASE_MAX];
+
+/* Histograms, written by the probe task only */
+static jitter_histogram_t jitter_histograms[JITTER_PHASE_MAX];
+
+/*******************************************************************************
+ * Function Name: jitter_probe_current_phase
+ *******************************************************************************
+ * Summary:
+ *  Returns the phase in progress with the highest precedence.
+ *
+ *******************************************************************************/
+static jitter_phase_t jitter_probe_current_phase(void)
+{
+    for (int32_t phase = (int32_t)JITTER_PHASE_MAX - 1; phase > (int32_t)JITTER_PHASE_IDLE; phase--)
+    {
+        if (jitter_phase_active[phase])
+        {
+            return (jitter_phase_t)phase;
+        }
+    }
+    return JITTER_PHASE_IDLE;
+}
+
+/*******************************************************************************
+ * Function Name: jitter_probe_late_us
+ *******************************************************************************
+ * Summary:
+ *  Returns the time since the start of a tick: the whole ticks counted since
+ *  then, and the part of the current tick elapsed on SysTick. Both come from
+ *  the tick clock itself, so every wake-up is measured against its own tick
+ *  and no drift between clocks builds up. After tickless idle, the current
+ *  tick starts when SysTick is restarted.
+ *
+ * Parameters:
+ *  TickType_t due : Tick the task was due on
+ *
+ *******************************************************************************/
+static uint32_t jitter_probe_late_us(TickType_t due)
+{
+    TickType_t ticks;
+    uint32_t load;
+    uint32_t elapsed;
+
+    taskENTER_CRITICAL();
+    ticks = xTaskGetTickCount();
+    load = SysTick->LOAD + 1u;
+    elapsed = load - SysTick->VAL;
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0u)
+    {
+        /* The tick ran out, but its interrupt waits for the critical section */
+        ticks++;
+        elapsed = load - SysTick->VAL;
+    }
+    taskEXIT_CRITICAL();
+
+    return ((uint32_t)(ticks - due) * JITTER_TICK_US) + (uint32_t)(((uint64_t)elapsed * JITTER_TICK_US) / load);
+}
+
+/*******************************************************************************
+ * Function Name: jitter_probe_task
+ *******************************************************************************
+ * Summary:
+ *  Wakes up every JITTER_PROBE_PERIOD_MS and records how late it is against
+ *  the tick it was due on. SysTick stops in deep sleep, so deep sleep is
+ *  locked out while the probe runs; tickless idle still sleeps.
+ *
+ *******************************************************************************/
+static void jitter_probe_task(void *args)
+{
+    TickType_t last_wake;
+    uint32_t late_us;
+    uint32_t bin;
+    jitter_histogram_t *histogram;
+
+    (void)args;
+
+    cyhal_syspm_lock_deepsleep();
+
+    last_wake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(JITTER_PROBE_PERIOD_MS));
+        late_us = jitter_probe_late_us(last_wake);
+
+        bin = 0u;
+        while ((bin < (JITTER_BIN_COUNT - 1u)) && (late_us >= jitter_bin_limits_us[bin]))
+        {
+            bin++;
+        }
+
+        histogram = &jitter_histograms[jitter_probe_current_phase()];
+        histogram->count++;
+        histogram->bins[bin]++;
+        if (late_us > histogram->max_us)
+        {
+            histogram->max_us = late_us;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: jitter_probe_start
+ *******************************************************************************
+ * Summary:
+ *  Starts the probe task.
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS or JITTER_PROBE_RSLT_ERR_NOMEM
+ *
+ *******************************************************************************/
+cy_rslt_t jitter_probe_start(void)
+{
+    rtos_stats_stack_register("JITTER PROBE", JITTER_PROBE_TASK_STACK_SIZE);
+    if (xTaskCreate(jitter_probe_task, "JITTER PROBE", JITTER_PROBE_TASK_STACK_SIZE, NULL,
+                    JITTER_PROBE_PRIORITY, NULL) != pdPASS)
+    {
+        return JITTER_PROBE_RSLT_ERR_NOMEM;
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: jitter_probe_phase
+ *******************************************************************************
+ * Summary:
+ *  Marks the start or the end of an OTA phase. Wake-ups are attributed to the
+ *  phase in progress with the highest precedence, or to idle.
+ *
+ * Parameters:
+ *  jitter_phase_t phase : Phase
+ *  bool active          : true when the phase starts, false when it ends
+ *
+ *******************************************************************************/
+void jitter_probe_phase(jitter_phase_t phase, bool active)
+{
+    if (phase < JITTER_PHASE_MAX)
+    {
+        jitter_phase_active[phase] = active;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: jitter_probe_report
+ *******************************************************************************
+ * Summary:
+ *  Prints the lateness histogram of every phase.
+ *
+ *******************************************************************************/
+void jitter_probe_report(void)
+{
+    const jitter_histogram_t *histogram;
+
+    printf("\nWake-up lateness of a %u ms task at priority %u (us):\n",
+           (unsigned int)JITTER_PROBE_PERIOD_MS, (unsigned int)JITTER_PROBE_PRIORITY);
+    printf("  %-14s %7s %6s %6s %6s %6s %6s %6s %6s %6s %6s %6s %6s\n", "PHASE", "COUNT", "MAX",
+           "<10", "<20", "<50", "<100", "<200", "<500", "<1k", "<2k", "<5k", ">=5k");
+
+    for (uint32_t phase = 0u; phase < JITTER_PHASE_MAX; phase++)
+    {
+        histogram = &jitter_histograms[phase];
+        printf("  %-14s %7lu %6lu", jitter_phase_names[phase],
+               (unsigned long)histogram->count, (unsigned long)histogram->max_us);
+        for (uint32_t bin = 0u; bin < JITTER_BIN_COUNT; bin++)
+        {
+            printf(" %6lu", (unsigned long)histogram->bins[bin]);
+        }
+        printf("\n");
+    }
+}
+
+#if defined(JITTER_PROBE_HOOKS)
+/*******************************************************************************
+ * Function Name: __wrap_flash_area_erase
+ *******************************************************************************
+ * Summary:
+ *  Marks the flash erase phase around the erase of the upgrade slot by the
+ *  OTA storage code.
+ *
+ *******************************************************************************/
+int __wrap_flash_area_erase(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    int ret;
+
+    jitter_probe_phase(JITTER_PHASE_FLASH_ERASE, true);
+    ret = __real_flash_area_erase(fa, off, len);
+    jitter_probe_phase(JITTER_PHASE_FLASH_ERASE, false);
+
+    return ret;
+}
+#endif /* JITTER_PROBE_HOOKS */
+
+/* [] END OF FILE */
@@ -0,0 +1,79 @@
+/******************************************************************************
+* File Name: jitter_probe.h
+*
+* Description: This file contains declarations of the wake-up jitter probe.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_JITTER_PROBE_H_
+#define SOURCE_JITTER_PROBE_H_
+
+#include <stdbool.h>
+#include "cy_result.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Result codes */
+#define JITTER_PROBE_RSLT_MODULE            (CY_RSLT_MODULE_MIDDLEWARE_BASE + 0xF7u)
+#define JITTER_PROBE_RSLT_ERR_NOMEM         CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, JITTER_PROBE_RSLT_MODULE, 1)
+
+/* Period and priority of the probe; the priority of the application tasks */
+#ifndef JITTER_PROBE_PERIOD_MS
+#define JITTER_PROBE_PERIOD_MS              (10u)
+#endif
+#ifndef JITTER_PROBE_PRIORITY
+#define JITTER_PROBE_PRIORITY               (configMAX_PRIORITIES - 3)
+#endif
+
+/*******************************************************************************
+* Data structures and enumerations
+********************************************************************************/
+/* OTA phases a wake-up is attributed to, lowest precedence first */
+typedef enum
+{
+    JITTER_PHASE_IDLE = 0,
+    JITTER_PHASE_DOWNLOAD,
+    JITTER_PHASE_HANDSHAKE,
+    JITTER_PHASE_FLASH_ERASE,
+    JITTER_PHASE_MAX
+} jitter_phase_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t jitter_probe_start(void);
+void jitter_probe_phase(jitter_phase_t phase, bool active);
+void jitter_probe_report(void);
+
+#endif /* SOURCE_JITTER_PROBE_H_ */
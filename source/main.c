@@ -48,7 +48,9 @@
 #include "cybsp.h"
 #include "cy_retarget_io.h"
 #include "ota_task.h"
-#include "led_task.h"
+#include "status_led.h"
+#include "rtos_stats.h"
+#include "heap_trace.h"
 
 /* FreeRTOS header file */
 #include <FreeRTOS.h>
@@ -61,19 +63,12 @@
 #define OTA_TASK_STACK_SIZE                 (1024 * 6)
 #define OTA_TASK_PRIORITY                   (configMAX_PRIORITIES - 3)
 
-/* OTA task configurations */
-#define LED_TASK_STACK_SIZE                 (configMINIMAL_STACK_SIZE)
-#define LED_TASK_PRIORITY                   (configMAX_PRIORITIES - 3)
-
 /*******************************************************************************
 * Global Variables
 ********************************************************************************/
 /* OTA task handle */
 TaskHandle_t ota_task_handle;
 
-/* LED task handle */
-TaskHandle_t led_task_handle;
-
 /* This enables RTOS aware debugging. */
 volatile int uxTopUsedPriority;
 
@@ -118,11 +113,22 @@ int main(void)
             APP_VERSION_MAJOR, APP_VERSION_MINOR, APP_VERSION_BUILD);
     printf("===============================================================\n\n");
 
-    /* Create the tasks */
+#if defined(HEAP_TRACE)
+    /* Print the allocations recorded since reset and all that follow */
+    if (heap_trace_start() != CY_RSLT_SUCCESS)
+    {
+        printf("Failed to start the heap trace.\n");
+    }
+#endif
+
+    /* Show the OTA state on the user LED */
+    result = status_led_init();
+    CY_ASSERT(result == CY_RSLT_SUCCESS);
+
+    /* Create the task; its size goes to the stack sizing report */
+    rtos_stats_stack_register("OTA TASK", OTA_TASK_STACK_SIZE);
     xTaskCreate(ota_task, "OTA TASK", OTA_TASK_STACK_SIZE, NULL,
                 OTA_TASK_PRIORITY, &ota_task_handle);
-    xTaskCreate(led_task, "LED TASK", LED_TASK_STACK_SIZE, NULL,
-                LED_TASK_PRIORITY, &led_task_handle);
 
     /* Start the FreeRTOS scheduler. */
     vTaskStartScheduler();
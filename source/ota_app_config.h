@@ -52,9 +52,34 @@
  */
 #define WIFI_SECURITY       (CY_WCM_SECURITY_WPA2_AES_PSK)
 
+/* Cache the BSSID, channel and PMK of the AP in flash after a successful join
+ * and use them for a directed join on the next boot. A full join is used if
+ * the directed join fails.
+ */
+#define ENABLE_WIFI_FAST_REJOIN     (true)
+
+/* Save the DHCP lease, DNS servers and gateway MAC address before the reboot
+ * that completes an OTA update, and use them to bring the network up without
+ * DHCP discovery and ARP on the next boot. DHCP then revalidates the lease in
+ * the background.
+ */
+#define ENABLE_NETWORK_LEASE_REUSE  (true)
+
 /* MQTT Broker endpoint */
 #define MQTT_BROKER_URL     "test.mosquitto.org"
 
+/* Keep the addresses of MQTT_BROKER_URL in a cache that is refreshed in the
+ * background and saved in flash, so that a slow or unavailable DNS server does
+ * not delay or fail an update check.
+ */
+#define ENABLE_DNS_CACHE    (true)
+
+/* Comma separated IPv4/IPv6 addresses of the broker used when it has never
+ * been resolved and DNS does not answer, e.g. "192.0.2.10,2001:db8::10".
+ * Leave empty to rely on DNS only.
+ */
+#define MQTT_BROKER_FALLBACK_ADDRS  ""
+
 /* MQTT Server Port */
 /************************************************************
  * Server Port for https://test.mosquitto.org/
@@ -67,6 +92,81 @@
 /* Macro to enable/disable TLS */
 #define ENABLE_TLS          (false)
 
+/* Save the TLS session in flash so that the first connection after a reboot
+ * can be resumed too. The session is always cached in RAM. The flash copy
+ * holds the session master secret; leave this disabled if the flash is not
+ * trusted.
+ */
+#define ENABLE_TLS_SESSION_PERSIST  (false)
+
+/* Fleet key of the PSK key exchange, as a hex string of up to 64 digits. Used
+ * when the build selects TLS_KEY_EXCHANGE=PSK or ECDHE_PSK in the Makefile;
+ * the certificates below are then not used. Every device derives its own key
+ * and identity (OTA_MQTT_ID and the unique ID of the device) from it; use
+ * scripts/psk_provision.py to add the device to the broker.
+ */
+#define TLS_PSK_FLEET_KEY           ""
+
+/* Download in the background: hold the download to the limits below, so the
+ * application tasks keep their timing while an update comes in. Pick them with
+ * the jitter benchmark and scripts/jitter_sim.py. (false) downloads at full
+ * speed. The limits need the GCC_ARM toolchain.
+ */
+#define ENABLE_OTA_THROTTLE         (false)
+#define OTA_THROTTLE_BYTES_PER_SEC  (16u * 1024u)   /* Download rate */
+#define OTA_THROTTLE_WRITES_PER_SEC (4u)            /* Chunks written per second */
+#define OTA_THROTTLE_CPU_PERMILLE   (200u)          /* Share of time spent writing chunks */
+
+/* Carousel mode: the image is cycled on a topic shared by many devices, see
+ * scripts/ota_carousel_publisher.py. The device takes every chunk from
+ * wherever it joins the cycle until the chunk is written, and reports its
+ * progress and completion on CAROUSEL_STATUS_TOPIC. Needs the GCC_ARM
+ * toolchain.
+ */
+#define ENABLE_OTA_CAROUSEL         (false)
+#define CAROUSEL_STATUS_TOPIC       "anycloud/test/ota/status"
+
+/* Leave the reboot into a downloaded update to the application instead of
+ * rebooting right away. The update is verified and the swap is staged when the
+ * download completes; the device then reboots once no service response was
+ * marked for OTA_REBOOT_IDLE_MS, or after OTA_REBOOT_MAX_DEFER_MS at the
+ * latest. See source/ota_reboot.h to reboot in a maintenance window instead.
+ */
+#define ENABLE_DEFERRED_REBOOT      (false)
+#define OTA_REBOOT_IDLE_MS          (30u * 1000u)           /* Idle time of the service */
+#define OTA_REBOOT_MAX_DEFER_MS     (24u * 3600u * 1000u)   /* Longest deferral, 0 for none */
+
+/* Keep the previous image until the update confirms itself: the update is
+ * confirmed once it has brought up the network and started the OTA agent, and
+ * MCUBoot reverts an update that resets before that. Set by building with
+ * OTA_ROLLBACK=1, which needs a swap mode of MCUBoot, see the Makefile.
+ */
+#ifndef OTA_ROLLBACK
+#define OTA_ROLLBACK                (0)
+#endif
+
+/* Time the ECC operations of the TLS handshake at startup. Also enabled by
+ * building with ECC_BENCHMARK=1, see scripts/tls_profile_bench.py.
+ */
+#ifndef ENABLE_ECC_BENCHMARK
+#define ENABLE_ECC_BENCHMARK        (false)
+#endif
+
+/* Measure the wake-up jitter of a task at the priority of the application
+ * tasks during every OTA phase, see source/jitter_probe.c. Also enabled by
+ * building with JITTER_BENCHMARK=1.
+ */
+#ifndef ENABLE_JITTER_BENCHMARK
+#define ENABLE_JITTER_BENCHMARK     (false)
+#endif
+
+/* Collect the FreeRTOS run-time statistics and sample them periodically, see
+ * source/rtos_stats.c. Also enabled by building with RTOS_STATS=1.
+ */
+#ifndef ENABLE_RTOS_STATS
+#define ENABLE_RTOS_STATS           (false)
+#endif
+
 /* MQTT identifier - less than 17 characters*/
 #define OTA_MQTT_ID         "CY_IOT_DEVICE"
 
@@ -79,6 +179,24 @@ const char * my_topics[ MQTT_TOPIC_FILTER_NUM ] =
         "anycloud/test/ota/image"
 };
 
+/* With ENABLE_RTOS_STATS, publish the CPU share of every task while the OTA
+ * agent is connected, in the binary format described in rtos_stats.c. View
+ * with scripts/rtos_stats_viewer.py. Off by default, as the statistics of
+ * every task go to the public broker every second.
+ */
+#define ENABLE_RTOS_STATS_TELEMETRY (false)
+
+/* Telemetry topic of this device */
+#define TELEMETRY_TOPIC     "anycloud/test/ota/telemetry/" OTA_MQTT_ID
+
+/* Sampling period of the run-time statistics, in milliseconds */
+#define RTOS_STATS_PERIOD_MS    (1000u)
+
+/* Period of the IoT pool and heap fragmentation report, in milliseconds, for
+ * soak tests over many OTA checks. 0 prints it only when an update completes.
+ */
+#define HEAP_REPORT_PERIOD_MS   (0u)
+
 /*
  * AWS IoT MQTT Mode - This parameter must be 1 when using the AWS IoT MQTT
  *                     server, 0 otherwise.
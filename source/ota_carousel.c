@@ -0,0 +1,396 @@
+/******************************************************************************
+* File Name: ota_carousel.c
+*
+* Description: This file contains the carousel mode of the OTA download. In
+* this mode the publisher cycles the chunks of one image on a topic shared by
+* many devices, and a device may subscribe at any point of the cycle. The
+* subscriptions of the OTA agent are routed through a filter that keeps a
+* bitmap of the chunks the agent has written to the upgrade slot: a chunk is
+* passed to the agent, in the order the chunks come, until its write
+* succeeds, and the repeats of later cycles are dropped after that. A chunk
+* the agent does not take, or fails to write, is passed again on the next
+* cycle. The device reports its progress on a status topic, and reports
+* completion once the agent has verified the image, which tells the publisher
+* when every device holds the image.
+*
+* Status message, JSON:
+*   {"id":"<device id>","version":"<major.minor.build>","held":<chunks>,"total":<chunks>,"complete":<bool>}
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS header files */
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "conn_trace.h"
+#include "ota_carousel.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Chunk header of the publisher, packed little endian, see cy_ota_mqtt.c */
+#define CAROUSEL_HEADER_MAGIC               "OTAImage"
+#define CAROUSEL_HEADER_MAGIC_LEN           (8u)
+#define CAROUSEL_HEADER_SIZE                (32u)
+#define CAROUSEL_OFS_VERSION                (12u)   /* 3 x uint16_t major, minor, build */
+#define CAROUSEL_OFS_TOTAL_SIZE             (18u)   /* uint32_t */
+#define CAROUSEL_OFS_IMAGE_OFFSET           (22u)   /* uint32_t */
+#define CAROUSEL_OFS_NUM_PAYLOADS           (28u)   /* uint16_t */
+#define CAROUSEL_OFS_PAYLOAD_INDEX          (30u)   /* uint16_t */
+
+/* Longest status message */
+#define CAROUSEL_STATUS_MAX_LEN             (144u)
+
+/* Time given to the MQTT library to send the completion status before the
+ * agent disconnects and reboots */
+#define CAROUSEL_COMPLETE_FLUSH_MS          (500u)
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* Image being collected; a chunk of another image starts over */
+typedef struct
+{
+    uint16_t version[3];
+    uint32_t total_size;
+    uint16_t num_payloads;
+} carousel_image_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static bool carousel_enabled;
+static const char *carousel_device_id;
+static const char *carousel_status_topic;
+
+/* Subscriptions handed to the MQTT library, and the callbacks of the agent */
+static IotMqttSubscription_t carousel_subscriptions[OTA_CAROUSEL_MAX_TOPICS];
+static IotMqttCallbackInfo_t carousel_agent_callbacks[OTA_CAROUSEL_MAX_TOPICS];
+
+/* Chunks of the image written by the agent. The MQTT callback reads the
+ * bitmap and starts it over; the storage write of the agent, which may run in
+ * another thread, sets its bits. Both change it in a critical section. */
+static carousel_image_t carousel_image;
+static uint32_t carousel_chunk_size;
+static uint8_t carousel_bitmap[(OTA_CAROUSEL_MAX_CHUNKS + 7u) / 8u];
+static uint32_t carousel_held;
+static uint32_t carousel_repeats;
+static bool carousel_complete;
+
+/*******************************************************************************
+ * Function Name: carousel_read_u16
+ *******************************************************************************
+ * Summary:
+ *  Reads an unaligned little endian 16-bit field of the chunk header.
+ *
+ *******************************************************************************/
+static uint16_t carousel_read_u16(const uint8_t *data)
+{
+    return (uint16_t)(data[0] | ((uint16_t)data[1] << 8));
+}
+
+/*******************************************************************************
+ * Function Name: carousel_read_u32
+ *******************************************************************************
+ * Summary:
+ *  Reads an unaligned little endian 32-bit field of the chunk header.
+ *
+ *******************************************************************************/
+static uint32_t carousel_read_u32(const uint8_t *data)
+{
+    return (uint32_t)carousel_read_u16(data) | ((uint32_t)carousel_read_u16(data + 2) << 16);
+}
+
+/*******************************************************************************
+ * Function Name: carousel_reset
+ *******************************************************************************
+ * Summary:
+ *  Forgets the chunks taken, for a new image or a new download.
+ *
+ *******************************************************************************/
+static void carousel_reset(void)
+{
+    taskENTER_CRITICAL();
+    memset(&carousel_image, 0, sizeof(carousel_image));
+    memset(carousel_bitmap, 0, sizeof(carousel_bitmap));
+    carousel_chunk_size = 0u;
+    carousel_held = 0u;
+    carousel_repeats = 0u;
+    carousel_complete = false;
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: carousel_publish_status
+ *******************************************************************************
+ * Summary:
+ *  Publishes the chunks held of the current image on the status topic.
+ *
+ *******************************************************************************/
+static void carousel_publish_status(void)
+{
+    char status[CAROUSEL_STATUS_MAX_LEN];
+    int length;
+
+    length = snprintf(status, sizeof(status),
+                      "{\"id\":\"%s\",\"version\":\"%u.%u.%u\",\"held\":%lu,\"total\":%u,\"complete\":%s}",
+                      carousel_device_id, carousel_image.version[0], carousel_image.version[1],
+                      carousel_image.version[2], (unsigned long)carousel_held, carousel_image.num_payloads,
+                      carousel_complete ? "true" : "false");
+    if ((length > 0) && ((size_t)length < sizeof(status)))
+    {
+        (void)conn_trace_publish(carousel_status_topic, status, (size_t)length);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: carousel_on_publish
+ *******************************************************************************
+ * Summary:
+ *  Receives the messages on the OTA topics in place of the agent. A chunk is
+ *  passed on until the agent has written it, and dropped when it comes again
+ *  after that; other messages are passed on as they are.
+ *
+ * Parameters:
+ *  void *context                 : Callback of the agent for this topic filter
+ *  IotMqttCallbackParam_t *param : Message
+ *
+ *******************************************************************************/
+static void carousel_on_publish(void *context, IotMqttCallbackParam_t *param)
+{
+    const IotMqttCallbackInfo_t *agent = (const IotMqttCallbackInfo_t *)context;
+    const uint8_t *payload = (const uint8_t *)param->u.message.info.pPayload;
+    carousel_image_t image = { { 0u, 0u, 0u }, 0u, 0u };
+    uint32_t offset;
+    uint16_t index;
+    uint8_t bit;
+    bool written;
+
+    if ((param->u.message.info.payloadLength < CAROUSEL_HEADER_SIZE) ||
+        (memcmp(payload, CAROUSEL_HEADER_MAGIC, CAROUSEL_HEADER_MAGIC_LEN) != 0))
+    {
+        agent->function(agent->pCallbackContext, param);
+        return;
+    }
+
+    for (uint32_t i = 0; i < 3u; i++)
+    {
+        image.version[i] = carousel_read_u16(payload + CAROUSEL_OFS_VERSION + (2u * i));
+    }
+    image.total_size = carousel_read_u32(payload + CAROUSEL_OFS_TOTAL_SIZE);
+    image.num_payloads = carousel_read_u16(payload + CAROUSEL_OFS_NUM_PAYLOADS);
+    offset = carousel_read_u32(payload + CAROUSEL_OFS_IMAGE_OFFSET);
+    index = carousel_read_u16(payload + CAROUSEL_OFS_PAYLOAD_INDEX);
+
+    if ((image.num_payloads > OTA_CAROUSEL_MAX_CHUNKS) || (index >= image.num_payloads))
+    {
+        agent->function(agent->pCallbackContext, param);
+        return;
+    }
+
+    if ((image.version[0] != carousel_image.version[0]) || (image.version[1] != carousel_image.version[1]) ||
+        (image.version[2] != carousel_image.version[2]) || (image.total_size != carousel_image.total_size) ||
+        (image.num_payloads != carousel_image.num_payloads))
+    {
+        /* Joined the cycle of a new image at this chunk */
+        carousel_reset();
+        taskENTER_CRITICAL();
+        carousel_image = image;
+        taskEXIT_CRITICAL();
+        printf("OTA carousel: image %u.%u.%u, %u chunks, joined at chunk %u\n",
+               image.version[0], image.version[1], image.version[2], image.num_payloads, index);
+    }
+
+    /* The storage write gives the image offset only; every chunk but the
+     * last one has the same size */
+    if ((index > 0u) && (carousel_chunk_size == 0u))
+    {
+        carousel_chunk_size = offset / index;
+    }
+
+    bit = (uint8_t)(1u << (index % 8u));
+    taskENTER_CRITICAL();
+    written = ((carousel_bitmap[index / 8u] & bit) != 0u);
+    taskEXIT_CRITICAL();
+    if (written)
+    {
+        carousel_repeats++;
+        return;
+    }
+
+    agent->function(agent->pCallbackContext, param);
+}
+
+/*******************************************************************************
+ * Function Name: ota_carousel_chunk_written
+ *******************************************************************************
+ * Summary:
+ *  Marks a chunk as held once the agent has written it to the upgrade slot,
+ *  and publishes the progress. A chunk that was not written stays unmarked,
+ *  so it is passed to the agent again on the next cycle. Called by the
+ *  storage write hook of ota_throttle.c.
+ *
+ * Parameters:
+ *  uint32_t offset : Offset of the chunk in the image
+ *  bool written    : The write succeeded
+ *
+ *******************************************************************************/
+void ota_carousel_chunk_written(uint32_t offset, bool written)
+{
+    uint32_t index;
+    uint8_t bit;
+    bool is_new = false;
+
+    if (!carousel_enabled || !written)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    if (offset == 0u)
+    {
+        index = 0u;
+    }
+    else if ((carousel_chunk_size > 0u) && ((offset % carousel_chunk_size) == 0u))
+    {
+        index = offset / carousel_chunk_size;
+    }
+    else
+    {
+        index = UINT32_MAX;
+    }
+
+    if (index < carousel_image.num_payloads)
+    {
+        bit = (uint8_t)(1u << (index % 8u));
+        is_new = ((carousel_bitmap[index / 8u] & bit) == 0u);
+        carousel_bitmap[index / 8u] |= bit;
+        carousel_held += is_new ? 1u : 0u;
+    }
+    taskEXIT_CRITICAL();
+
+    if (is_new && ((carousel_held == 1u) || (carousel_held == carousel_image.num_payloads) ||
+                   ((carousel_held % OTA_CAROUSEL_STATUS_EVERY) == 0u)))
+    {
+        carousel_publish_status();
+    }
+    if (is_new && (carousel_held == carousel_image.num_payloads))
+    {
+        printf("OTA carousel: all %u chunks written, %lu repeats dropped\n",
+               carousel_image.num_payloads, (unsigned long)carousel_repeats);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: ota_carousel_complete
+ *******************************************************************************
+ * Summary:
+ *  Reports completion on the status topic once the agent has verified the
+ *  image, and gives the MQTT library time to send it before the agent
+ *  disconnects. Called from the OTA callback in CY_OTA_STATE_OTA_COMPLETE.
+ *
+ *******************************************************************************/
+void ota_carousel_complete(void)
+{
+    if (!carousel_enabled || (carousel_image.num_payloads == 0u))
+    {
+        return;
+    }
+
+    carousel_complete = true;
+    carousel_publish_status();
+    vTaskDelay(pdMS_TO_TICKS(CAROUSEL_COMPLETE_FLUSH_MS));
+}
+
+/*******************************************************************************
+ * Function Name: ota_carousel_start
+ *******************************************************************************
+ * Summary:
+ *  Enables the carousel mode for the next subscriptions of the OTA agent.
+ *
+ * Parameters:
+ *  const char *device_id    : Identifier of the device in the status messages
+ *  const char *status_topic : Topic of the status messages
+ *
+ *******************************************************************************/
+void ota_carousel_start(const char *device_id, const char *status_topic)
+{
+    carousel_device_id = device_id;
+    carousel_status_topic = status_topic;
+    carousel_enabled = true;
+}
+
+/*******************************************************************************
+ * Function Name: ota_carousel_subscriptions
+ *******************************************************************************
+ * Summary:
+ *  Returns the subscriptions to make in place of those of the OTA agent: the
+ *  same topic filters, with the carousel filter in front of the callbacks of
+ *  the agent. Each subscription of the agent starts a new download, so the
+ *  chunks taken are forgotten. Called by the subscribe hook of conn_trace.c.
+ *
+ * Parameters:
+ *  const IotMqttSubscription_t *list : Subscriptions of the agent
+ *  size_t count                      : Number of subscriptions
+ *
+ * Return:
+ *  const IotMqttSubscription_t * : Subscriptions to make
+ *
+ *******************************************************************************/
+const IotMqttSubscription_t *ota_carousel_subscriptions(const IotMqttSubscription_t *list, size_t count)
+{
+    if (!carousel_enabled || (count > OTA_CAROUSEL_MAX_TOPICS))
+    {
+        return list;
+    }
+
+    carousel_reset();
+    for (size_t i = 0; i < count; i++)
+    {
+        carousel_subscriptions[i] = list[i];
+        carousel_agent_callbacks[i] = list[i].callback;
+        carousel_subscriptions[i].callback.function = carousel_on_publish;
+        carousel_subscriptions[i].callback.pCallbackContext = &carousel_agent_callbacks[i];
+    }
+
+    return carousel_subscriptions;
+}
+
+/* [] END OF FILE */
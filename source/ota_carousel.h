@@ -0,0 +1,72 @@
+/******************************************************************************
+* File Name: ota_carousel.h
+*
+* Description: This file contains the public interface of the carousel mode of
+* the OTA download.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_OTA_CAROUSEL_H_
+#define SOURCE_OTA_CAROUSEL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "iot_mqtt.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Chunks of an image tracked by the bitmap; images with more chunks are passed
+ * to the OTA agent as they come. 512 chunks of 4 KB cover the upgrade slot. */
+#ifndef OTA_CAROUSEL_MAX_CHUNKS
+#define OTA_CAROUSEL_MAX_CHUNKS             (512u)
+#endif
+
+/* Topic filters of the OTA agent that can be filtered */
+#define OTA_CAROUSEL_MAX_TOPICS             (4u)
+
+/* A progress status is published every this many new chunks */
+#ifndef OTA_CAROUSEL_STATUS_EVERY
+#define OTA_CAROUSEL_STATUS_EVERY           (32u)
+#endif
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void ota_carousel_start(const char *device_id, const char *status_topic);
+void ota_carousel_chunk_written(uint32_t offset, bool written);
+void ota_carousel_complete(void);
+const IotMqttSubscription_t *ota_carousel_subscriptions(const IotMqttSubscription_t *list, size_t count);
+
+#endif /* SOURCE_OTA_CAROUSEL_H_ */
@@ -0,0 +1,366 @@
+/******************************************************************************
+* File Name: ota_reboot.c
+*
+* Description: This file contains the deferred OTA reboot. When the OTA agent
+* does not reboot on its own, the update is left verified in the upgrade slot
+* and marked pending, so the reboot only runs the swap of MCUboot. A low
+* priority task reboots the device when the application allows it: in its
+* maintenance window, after its service has been idle for a while, or at the
+* latest after a deadline. The downtime of the service is measured across the
+* reboot, from the last service response before the reset to the first one
+* after it, and printed by the new image.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <string.h>
+#include <time.h>
+
+/* FreeRTOS header files */
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "app_nvm.h"
+#include "rtos_stats.h"
+#include "ota_reboot.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Reboot task configurations */
+#define OTA_REBOOT_TASK_STACK_SIZE          (1024u)
+#define OTA_REBOOT_TASK_PRIORITY            (tskIDLE_PRIORITY + 1)
+
+/* Version of the downtime record; bump when ota_reboot_record_t changes */
+#define OTA_REBOOT_RECORD_VERSION           (1u)
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* Written right before the reset, read by the next boot */
+typedef struct
+{
+    uint32_t version;
+    uint32_t before_reset_ms;       /* Last service response to the reset */
+    uint32_t reset_rtc_secs;        /* RTC at the reset, 0 without the RTC */
+} ota_reboot_record_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static ota_reboot_params_t reboot_params;
+
+/* Reboot task, created when an update is staged */
+static TaskHandle_t reboot_task_handle;
+
+/* Conditions of the reboot, set by ota_reboot_when() */
+static volatile bool reboot_scheduled;
+static ota_reboot_window_cb_t reboot_in_window;
+static void *reboot_window_arg;
+static uint32_t reboot_idle_ms;
+static uint32_t reboot_max_defer_ms;
+
+/* Time the update was staged and of the last service response, in ticks */
+static TickType_t reboot_staged_tick;
+static volatile TickType_t reboot_service_tick;
+static volatile bool reboot_service_marked;
+
+/* Runs on across the reset when it was enabled by an earlier boot */
+static cyhal_rtc_t reboot_rtc;
+static bool reboot_rtc_ok;
+
+/* Record of the previous boot, reported at the first service response */
+static ota_reboot_record_t reboot_last;
+static bool reboot_measuring;
+
+/*******************************************************************************
+ * Function Name: ota_reboot_rtc_secs
+ *******************************************************************************
+ * Summary:
+ *  Returns the RTC in seconds, or 0 if the RTC is not available.
+ *
+ *******************************************************************************/
+static uint32_t ota_reboot_rtc_secs(void)
+{
+    struct tm now;
+
+    if (!reboot_rtc_ok || (cyhal_rtc_read(&reboot_rtc, &now) != CY_RSLT_SUCCESS))
+    {
+        return 0u;
+    }
+
+    return (uint32_t)mktime(&now);
+}
+
+/*******************************************************************************
+ * Function Name: ota_reboot_elapsed_ms
+ *******************************************************************************
+ * Summary:
+ *  Returns the time since a tick, in ms.
+ *
+ *******************************************************************************/
+static uint32_t ota_reboot_elapsed_ms(TickType_t since)
+{
+    return (uint32_t)((xTaskGetTickCount() - since) * portTICK_PERIOD_MS);
+}
+
+/*******************************************************************************
+ * Function Name: ota_reboot_ready
+ *******************************************************************************
+ * Summary:
+ *  Checks the conditions set by ota_reboot_when(). The service is idle when it
+ *  has not responded for idle_ms, counted from the staging of the update at
+ *  the earliest.
+ *
+ *******************************************************************************/
+static bool ota_reboot_ready(void)
+{
+    TickType_t last = reboot_staged_tick;
+
+    if ((reboot_max_defer_ms > 0u) && (ota_reboot_elapsed_ms(reboot_staged_tick) >= reboot_max_defer_ms))
+    {
+        printf("OTA reboot: deferred for the longest time allowed, rebooting now\n");
+        return true;
+    }
+
+    if ((reboot_in_window != NULL) && !reboot_in_window(reboot_window_arg))
+    {
+        return false;
+    }
+
+    if (reboot_service_marked && ((TickType_t)(reboot_service_tick - last) < (portMAX_DELAY / 2u)))
+    {
+        last = reboot_service_tick;
+    }
+
+    return (ota_reboot_elapsed_ms(last) >= reboot_idle_ms);
+}
+
+/*******************************************************************************
+ * Function Name: ota_reboot_task
+ *******************************************************************************
+ * Summary:
+ *  Hands the staged update to the application, waits for the conditions it
+ *  schedules, and resets the device. The downtime record is written last, so
+ *  the time taken by the reset callback counts as downtime.
+ *
+ * Parameters:
+ *  void *args : Task parameter defined during task creation (unused)
+ *
+ *******************************************************************************/
+static void ota_reboot_task(void *args)
+{
+    ota_reboot_record_t record;
+
+    (void)args;
+
+    if (reboot_params.staged_cb != NULL)
+    {
+        reboot_params.staged_cb(reboot_params.cb_arg);
+    }
+
+    while (!reboot_scheduled || !ota_reboot_ready())
+    {
+        (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(OTA_REBOOT_POLL_MS));
+    }
+
+    if (reboot_params.reset_cb != NULL)
+    {
+        reboot_params.reset_cb(reboot_params.cb_arg);
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.version = OTA_REBOOT_RECORD_VERSION;
+    record.before_reset_ms = reboot_service_marked ? ota_reboot_elapsed_ms(reboot_service_tick) : 0u;
+    record.reset_rtc_secs = ota_reboot_rtc_secs();
+    if (app_nvm_write(APP_NVM_ID_OTA_REBOOT, &record, sizeof(record)) != CY_RSLT_SUCCESS)
+    {
+        printf("OTA reboot: failed to save the downtime record\n");
+    }
+
+    rtos_stats_stack_checkpoint();
+    printf("OTA reboot: resetting into the update\n");
+    vTaskDelay(pdMS_TO_TICKS(10u));
+    NVIC_SystemReset();
+}
+
+/*******************************************************************************
+ * Function Name: ota_reboot_init
+ *******************************************************************************
+ * Summary:
+ *  Sets the callbacks of the application and takes the downtime record of a
+ *  reboot into an update. The RTC is enabled here, so that it runs across the
+ *  next reset. Call once, after app_nvm_init().
+ *
+ * Parameters:
+ *  const ota_reboot_params_t *params : Callbacks of the application
+ *
+ *******************************************************************************/
+void ota_reboot_init(const ota_reboot_params_t *params)
+{
+    if (params != NULL)
+    {
+        reboot_params = *params;
+    }
+
+    /* The RTC keeps its time over a reset once it was initialized */
+    reboot_rtc_ok = (cyhal_rtc_init(&reboot_rtc) == CY_RSLT_SUCCESS);
+
+    if ((app_nvm_read(APP_NVM_ID_OTA_REBOOT, &reboot_last, sizeof(reboot_last)) == CY_RSLT_SUCCESS) &&
+        (reboot_last.version == OTA_REBOOT_RECORD_VERSION))
+    {
+        reboot_measuring = true;
+    }
+    (void)app_nvm_erase(APP_NVM_ID_OTA_REBOOT);
+
+    rtos_stats_stack_register("OTA REBOOT", OTA_REBOOT_TASK_STACK_SIZE);
+}
+
+/*******************************************************************************
+ * Function Name: ota_reboot_staged
+ *******************************************************************************
+ * Summary:
+ *  Tells that the OTA agent staged an update: the image is verified and the
+ *  swap is pending. Starts the reboot task, which calls the staged callback of
+ *  the application. Safe to call from the OTA callback.
+ *
+ *******************************************************************************/
+void ota_reboot_staged(void)
+{
+    if (reboot_task_handle != NULL)
+    {
+        return;
+    }
+
+    reboot_staged_tick = xTaskGetTickCount();
+    if (xTaskCreate(ota_reboot_task, "OTA REBOOT", OTA_REBOOT_TASK_STACK_SIZE, NULL,
+                    OTA_REBOOT_TASK_PRIORITY, &reboot_task_handle) != pdPASS)
+    {
+        printf("OTA reboot: failed to start the reboot task, rebooting now\n");
+        NVIC_SystemReset();
+    }
+}
+
+/*******************************************************************************
+ * Function Name: ota_reboot_is_staged
+ *******************************************************************************
+ * Summary:
+ *  Returns true once an update waits for the reboot.
+ *
+ *******************************************************************************/
+bool ota_reboot_is_staged(void)
+{
+    return (reboot_task_handle != NULL);
+}
+
+/*******************************************************************************
+ * Function Name: ota_reboot_when
+ *******************************************************************************
+ * Summary:
+ *  Schedules the reboot into the staged update. The device reboots inside the
+ *  maintenance window once the service has been idle for idle_ms, or after
+ *  max_defer_ms whatever the service does. Calling it again replaces the
+ *  conditions. ota_reboot_when(NULL, NULL, 0, 0) reboots right away.
+ *
+ * Parameters:
+ *  ota_reboot_window_cb_t in_window : Maintenance window check, NULL for any time
+ *  void *window_arg                 : Argument of in_window
+ *  uint32_t idle_ms                 : Time without a service response, in ms
+ *  uint32_t max_defer_ms            : Deadline from the staging, in ms; 0 for none
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, or OTA_REBOOT_RSLT_ERR_NOT_STAGED if no update
+ *              is staged
+ *
+ *******************************************************************************/
+cy_rslt_t ota_reboot_when(ota_reboot_window_cb_t in_window, void *window_arg,
+                          uint32_t idle_ms, uint32_t max_defer_ms)
+{
+    if (reboot_task_handle == NULL)
+    {
+        return OTA_REBOOT_RSLT_ERR_NOT_STAGED;
+    }
+
+    taskENTER_CRITICAL();
+    reboot_in_window = in_window;
+    reboot_window_arg = window_arg;
+    reboot_idle_ms = idle_ms;
+    reboot_max_defer_ms = max_defer_ms;
+    reboot_scheduled = true;
+    taskEXIT_CRITICAL();
+
+    xTaskNotifyGive(reboot_task_handle);
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: ota_reboot_service_mark
+ *******************************************************************************
+ * Summary:
+ *  Marks a response of the service of the application. The marks tell when
+ *  the service is idle, and the first mark after a reboot into an update
+ *  prints the downtime of the service: the time from the last mark to the
+ *  reset, and from the reset to this mark. The RTC covers the time spent in
+ *  MCUboot, at a resolution of a second.
+ *
+ *******************************************************************************/
+void ota_reboot_service_mark(void)
+{
+    uint32_t after_boot_ms;
+    uint32_t rtc_secs;
+
+    reboot_service_tick = xTaskGetTickCount();
+    reboot_service_marked = true;
+
+    if (!reboot_measuring)
+    {
+        return;
+    }
+    reboot_measuring = false;
+
+    after_boot_ms = (uint32_t)(reboot_service_tick * portTICK_PERIOD_MS);
+    rtc_secs = ota_reboot_rtc_secs();
+    printf("OTA reboot downtime: %lu ms from the last response to the reset, %lu ms from the start of the "
+           "update to the first response\n",
+           (unsigned long)reboot_last.before_reset_ms, (unsigned long)after_boot_ms);
+    if ((reboot_last.reset_rtc_secs != 0u) && (rtc_secs >= reboot_last.reset_rtc_secs))
+    {
+        printf("OTA reboot downtime: %lu s from the last to the first response by the RTC, swap included\n",
+               (unsigned long)((rtc_secs - reboot_last.reset_rtc_secs) + (reboot_last.before_reset_ms / 1000u)));
+    }
+}
+
+/* [] END OF FILE */
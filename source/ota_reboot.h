@@ -0,0 +1,85 @@
+/******************************************************************************
+* File Name: ota_reboot.h
+*
+* Description: This file contains the public interface of the deferred OTA
+* reboot.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_OTA_REBOOT_H_
+#define SOURCE_OTA_REBOOT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cy_result.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Result codes returned by the ota_reboot functions */
+#define OTA_REBOOT_RSLT_MODULE              (CY_RSLT_MODULE_MIDDLEWARE_BASE + 0xF8u)
+#define OTA_REBOOT_RSLT_ERR_NOT_STAGED      CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, OTA_REBOOT_RSLT_MODULE, 1)
+
+/* Interval at which the reboot conditions are checked, in ms */
+#ifndef OTA_REBOOT_POLL_MS
+#define OTA_REBOOT_POLL_MS                  (1000u)
+#endif
+
+/*******************************************************************************
+* Data structures and enumerations
+********************************************************************************/
+/* Returns true while the device is inside its maintenance window */
+typedef bool (*ota_reboot_window_cb_t)(void *arg);
+
+/* Notification of the reboot task */
+typedef void (*ota_reboot_cb_t)(void *arg);
+
+/* Callbacks of the application, all run by the reboot task */
+typedef struct
+{
+    ota_reboot_cb_t staged_cb;      /* An update is staged; schedule the reboot from here */
+    ota_reboot_cb_t reset_cb;       /* Runs right before the reset */
+    void *cb_arg;
+} ota_reboot_params_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void ota_reboot_init(const ota_reboot_params_t *params);
+void ota_reboot_staged(void);
+bool ota_reboot_is_staged(void);
+cy_rslt_t ota_reboot_when(ota_reboot_window_cb_t in_window, void *window_arg,
+                          uint32_t idle_ms, uint32_t max_defer_ms);
+void ota_reboot_service_mark(void);
+
+#endif /* SOURCE_OTA_REBOOT_H_ */
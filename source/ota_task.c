@@ -48,9 +48,13 @@
 #include "cy_iot_network_secured_socket.h"
 #include "iot_mqtt.h"
 
+/* TLS support of the secure sockets library */
+#include "cy_tls.h"
+
 /* FreeRTOS header file */
 #include <FreeRTOS.h>
 #include <task.h>
+#include <event_groups.h>
 
 /* OTA API */
 #include "cy_ota_api.h"
@@ -58,20 +62,90 @@
 /* App specific configuration */
 #include "ota_app_config.h"
 
+/* DER copies of the credentials, generated from ota_app_config.h by
+ * scripts/pem_to_der.py before the build. Credentials that were not converted
+ * are used as PEM strings. */
+#if defined(OTA_CREDENTIALS_DER)
+#include "ota_credentials_der.h"
+#endif
+
+#ifndef OTA_ROOT_CA
+#define OTA_ROOT_CA             ROOT_CA_CERTIFICATE
+#define OTA_ROOT_CA_LEN         sizeof(ROOT_CA_CERTIFICATE)
+#endif
+#ifndef OTA_CLIENT_CERT
+#define OTA_CLIENT_CERT         CLIENT_CERTIFICATE
+#define OTA_CLIENT_CERT_LEN     sizeof(CLIENT_CERTIFICATE)
+#endif
+#ifndef OTA_CLIENT_KEY
+#define OTA_CLIENT_KEY          CLIENT_KEY
+#define OTA_CLIENT_KEY_LEN      sizeof(CLIENT_KEY)
+#endif
+
+/* Wi-Fi join with fast rejoin support */
+#include "wifi_connect.h"
+
+/* Startup timeline */
+#include "app_trace.h"
+
+/* Broker address cache */
+#include "dns_cache.h"
+
+/* TLS hooks of the MQTT connection */
+#include "ota_tls.h"
+
+/* Flash record store */
+#include "app_nvm.h"
+
+/* ECC benchmark of the TLS profile */
+#include "ecc_bench.h"
+
+/* OTA state on the user LED */
+#include "status_led.h"
+
+/* Wake-up jitter of the application tasks during OTA */
+#include "jitter_probe.h"
+
+/* Background download limits */
+#include "ota_throttle.h"
+
+/* Reboot into an update under the control of the application */
+#include "ota_reboot.h"
+
+/* Chunk bitmap of the carousel mode */
+#include "ota_carousel.h"
+
+/* Size-class pools of the IoT SDK */
+#include "iot_pool.h"
+
+/* Run-time statistics telemetry and stack sizing */
+#include "rtos_stats.h"
+#include "lwip/opt.h"
+
 /*******************************************************************************
 * Macros
 ********************************************************************************/
-/* MAX connection retries to join WI-FI AP */
-#define MAX_CONNECTION_RETRIES              (10u)
+/* Wi-Fi bring-up task configurations. The task exits once connected. */
+#define WIFI_TASK_STACK_SIZE                (1024 * 2)
+#define WIFI_TASK_PRIORITY                  (configMAX_PRIORITIES - 3)
+
+/* Wi-Fi bring-up progress, signaled through wifi_events */
+#define WIFI_EVENT_STACK_READY              (1u << 0)   /* Connection manager and lwIP initialized */
+#define WIFI_EVENT_CONNECTED                (1u << 1)   /* Associated and IP address assigned */
+#define WIFI_EVENT_FAILED                   (1u << 2)   /* Configuration rejected */
 
-/* Wait between connection retries */
-#define WIFI_CONN_RETRY_DELAY_MS            (500)
+/* Threads of the network libraries, for the stack sizing report. Both ports
+ * create them through abstraction-rtos, which takes the size in bytes. */
+#define IOT_THREAD_NAME                     "iot_thread"
 
 /*******************************************************************************
 * Forward declaration
 ********************************************************************************/
 cy_rslt_t connect_to_wifi_ap(void);
+void wifi_task(void *args);
 void ota_callback(cy_ota_cb_reason_t reason, uint32_t value, void *cb_arg );
+void update_staged_callback(void *arg);
+void update_reset_callback(void *arg);
 
 /*******************************************************************************
 * Global Variables
@@ -79,15 +153,18 @@ void ota_callback(cy_ota_cb_reason_t reason, uint32_t value, void *cb_arg );
 /* OTA context */
 cy_ota_context_ptr ota_context;
 
+/* Wi-Fi bring-up progress */
+static EventGroupHandle_t wifi_events;
+
 /* MQTT Credentials for OTA */
 struct IotNetworkCredentials credentials =
 {
-    .pRootCa = ROOT_CA_CERTIFICATE,
-    .rootCaSize = sizeof(ROOT_CA_CERTIFICATE),
-    .pClientCert = CLIENT_CERTIFICATE,
-    .clientCertSize = sizeof(CLIENT_CERTIFICATE),
-    .pPrivateKey = CLIENT_KEY,
-    .privateKeySize = sizeof(CLIENT_KEY),
+    .pRootCa = OTA_ROOT_CA,
+    .rootCaSize = OTA_ROOT_CA_LEN,
+    .pClientCert = OTA_CLIENT_CERT,
+    .clientCertSize = OTA_CLIENT_CERT_LEN,
+    .pPrivateKey = OTA_CLIENT_KEY,
+    .privateKeySize = OTA_CLIENT_KEY_LEN,
 };
 
 /* Network parameters for OTA */
@@ -118,14 +195,37 @@ cy_ota_agent_params_t ota_agent_params =
 {
     .cb_func = ota_callback,
     .cb_arg = &ota_context,
-    .reboot_upon_completion = 1,
+    .reboot_upon_completion = (ENABLE_DEFERRED_REBOOT == true) ? 0 : 1,
+    .validate_after_reboot = OTA_ROLLBACK,
+};
+
+/* Callbacks of the deferred reboot */
+#if (ENABLE_DEFERRED_REBOOT == true)
+ota_reboot_params_t ota_reboot_params =
+{
+    .staged_cb = update_staged_callback,
+    .reset_cb = update_reset_callback,
+    .cb_arg = &ota_context
 };
+#endif
+
+/* Limits of the background download, applied next to ota_agent_params */
+#if (ENABLE_OTA_THROTTLE == true)
+ota_throttle_params_t ota_throttle_params =
+{
+    .max_bytes_per_sec = OTA_THROTTLE_BYTES_PER_SEC,
+    .max_writes_per_sec = OTA_THROTTLE_WRITES_PER_SEC,
+    .max_cpu_permille = OTA_THROTTLE_CPU_PERMILLE
+};
+#endif
 
 /*******************************************************************************
  * Function Name: ota_task
  *******************************************************************************
  * Summary:
- *  Task to initialize required libraries and start OTA agent.
+ *  Task to initialize required libraries and start OTA agent. The libraries
+ *  are initialized while wifi_task() joins the AP, and the OTA agent is
+ *  started once the network is up.
  *
  * Parameters:
  *  void *args : Task parameter defined during task creation (unused)
@@ -136,68 +236,249 @@ cy_ota_agent_params_t ota_agent_params =
  *******************************************************************************/
 void ota_task(void *args)
 {
-    /* Connect to Wi-Fi AP */
-    if( connect_to_wifi_ap() != CY_RSLT_SUCCESS )
+    EventBits_t wifi_status;
+
+#if (ENABLE_ECC_BENCHMARK == true)
+    /* Handshake cost of the TLS profile; runs before anything else competes for the CPU */
+    ecc_bench_run();
+#endif
+
+#if (ENABLE_JITTER_BENCHMARK == true)
+    /* Probe from the start, so the first TLS handshake is measured */
+    if( jitter_probe_start() != CY_RSLT_SUCCESS )
+    {
+        printf("\n Failed to start the jitter probe.\n");
+    }
+#endif
+
+    /* Initialize the flash record store before the Wi-Fi task and this task
+     * can race for it */
+    if( app_nvm_init() != CY_RSLT_SUCCESS )
+    {
+        printf("\n Failed to initialize the flash record store.\n");
+    }
+
+#if (ENABLE_DEFERRED_REBOOT == true)
+    /* Picks up the downtime record if this boot runs a new update */
+    ota_reboot_init(&ota_reboot_params);
+#endif
+
+    /* Join the Wi-Fi AP in the background; none of the steps below needs the
+     * network, so they run while the radio associates and DHCP completes. */
+    rtos_stats_stack_register("WIFI TASK", WIFI_TASK_STACK_SIZE);
+    rtos_stats_stack_register(TCPIP_THREAD_NAME, TCPIP_THREAD_STACKSIZE / sizeof(StackType_t));
+    rtos_stats_stack_register(IOT_THREAD_NAME, IOT_THREAD_DEFAULT_STACK_SIZE / sizeof(StackType_t));
+
+    wifi_events = xEventGroupCreate();
+    if( (wifi_events == NULL) ||
+        (xTaskCreate(wifi_task, "WIFI TASK", WIFI_TASK_STACK_SIZE, NULL,
+                     WIFI_TASK_PRIORITY, NULL) != pdPASS) )
     {
-        printf("\n Failed to connect to Wi-FI AP.\n");
+        printf("\n Failed to start the Wi-Fi bring-up task.\n");
         CY_ASSERT(0);
     }
 
     /* Initialize the underlying support code that is needed for OTA and MQTT */
+    app_trace_begin("IoT SDK init");
+#if defined(IOT_POOL_ALLOCATOR)
+    iot_pool_init();
+#endif
     if ( !IotSdk_Init() )
     {
         printf("\n IotSdk_Init Failed.\n");
         CY_ASSERT(0);
     }
+    app_trace_end("IoT SDK init");
+
+    /* Initialize the MQTT subsystem */
+    app_trace_begin("MQTT init");
+    if( IotMqtt_Init() != IOT_MQTT_SUCCESS )
+    {
+        printf("\n IotMqtt_Init Failed.\n");
+        CY_ASSERT(0);
+    }
+    app_trace_end("MQTT init");
+
+    /* Secure sockets sit on top of lwIP, which the connection manager initializes */
+    xEventGroupWaitBits(wifi_events, WIFI_EVENT_STACK_READY, pdFALSE, pdFALSE, portMAX_DELAY);
 
     /* Call the Network Secured Sockets initialization function. */
+    app_trace_begin("secure sockets init");
     if( IotNetworkSecureSockets_Init() != IOT_NETWORK_SUCCESS )
     {
         printf("\n IotNetworkSecureSockets_Init Failed.\n");
         CY_ASSERT(0);
     }
+    app_trace_end("secure sockets init");
 
-    /* Initialize the MQTT subsystem */
-    if( IotMqtt_Init() != IOT_MQTT_SUCCESS )
+#if (ENABLE_TLS == true)
+    /* Parse the root CA once into the global trust store while the radio joins,
+     * instead of on every connection. */
+    app_trace_begin("root CA parse");
+    if( cy_tls_load_global_root_ca_certificates(OTA_ROOT_CA, OTA_ROOT_CA_LEN) == CY_RSLT_SUCCESS )
     {
-        printf("\n IotMqtt_Init Failed.\n");
-        CY_ASSERT(0);
+        credentials.pRootCa = NULL;
+        credentials.rootCaSize = 0;
     }
+    else
+    {
+        printf("\n Failed to pre-parse the root CA, it is parsed on every connection instead.\n");
+    }
+    app_trace_end("root CA parse");
+
+    /* Resume the TLS session on reconnects */
+    ota_tls_init((ENABLE_TLS_SESSION_PERSIST == true) ? OTA_TLS_FLAG_PERSIST_SESSION : 0u);
+
+#if defined(OTA_TLS_PSK)
+    /* The pre-shared key replaces the certificates */
+    if( ota_tls_set_psk(TLS_PSK_FLEET_KEY, OTA_MQTT_ID) == CY_RSLT_SUCCESS )
+    {
+        credentials.pRootCa = NULL;
+        credentials.rootCaSize = 0;
+        credentials.pClientCert = NULL;
+        credentials.clientCertSize = 0;
+        credentials.pPrivateKey = NULL;
+        credentials.privateKeySize = 0;
+    }
+    else
+    {
+        printf("\n TLS_PSK_FLEET_KEY is not a valid hex key; the PSK handshake will fail.\n");
+    }
+#endif
+#endif
 
     /* Add the network interface to the OTA network parameters */
     ota_network_params.network_interface = (void *)IOT_NETWORK_INTERFACE_CY_SECURE_SOCKETS;
 
+    /* Everything else needs the network */
+    app_trace_begin("wait for network");
+    wifi_status = xEventGroupWaitBits(wifi_events, WIFI_EVENT_CONNECTED | WIFI_EVENT_FAILED,
+                                      pdFALSE, pdFALSE, portMAX_DELAY);
+    app_trace_end("wait for network");
+    if( (wifi_status & WIFI_EVENT_FAILED) != 0u )
+    {
+        printf("\n Failed to connect to Wi-FI AP. OTA is disabled until the configuration is fixed.\n");
+        vTaskSuspend( NULL );
+    }
+
+#if (ENABLE_DEFERRED_REBOOT == true)
+    /* The example has no service of its own; the network coming up stands in
+     * for its first response */
+    ota_reboot_service_mark();
+#endif
+
+#if (ENABLE_DNS_CACHE == true)
+    /* Make the broker resolvable before the first check */
+    app_trace_begin("broker address");
+    if( dns_cache_start(MQTT_BROKER_URL, MQTT_BROKER_FALLBACK_ADDRS) != CY_RSLT_SUCCESS )
+    {
+        printf("\n Starting the broker address cache failed. Every check resolves the broker.\n");
+    }
+    app_trace_end("broker address");
+#endif
+
+#if (ENABLE_OTA_THROTTLE == true)
+    ota_throttle_set(&ota_throttle_params);
+#endif
+
+#if (ENABLE_OTA_CAROUSEL == true)
+    ota_carousel_start(OTA_MQTT_ID, CAROUSEL_STATUS_TOPIC);
+#endif
+
     /* Initialize and start the OTA agent */
+    app_trace_begin("OTA agent start");
     if( cy_ota_agent_start(&ota_network_params, &ota_agent_params, &ota_context) != CY_RSLT_SUCCESS )
     {
         printf("\n Initializing and starting the OTA agent failed.\n");
         CY_ASSERT(0);
     }
+    app_trace_end("OTA agent start");
+
+#if (OTA_ROLLBACK == 1)
+    /* The update works; keep it instead of reverting on the next reset */
+    if( cy_ota_validated() != CY_RSLT_SUCCESS )
+    {
+        printf("\n Failed to confirm the running image.\n");
+    }
+#endif
 
+#if (ENABLE_RTOS_STATS == true)
+    /* Without telemetry or a run-time counter, the samples only feed the stack
+     * sizing report; rtos_stats_start() prints why the counter is missing */
+    if( rtos_stats_start(ENABLE_RTOS_STATS_TELEMETRY ? TELEMETRY_TOPIC : NULL,
+                         RTOS_STATS_PERIOD_MS) == RTOS_STATS_RSLT_ERR_NOMEM )
+    {
+        printf("\n Failed to start the run-time statistics sampler.\n");
+    }
+#endif
+
+    app_trace_dump("Startup timeline");
+
+#if (HEAP_REPORT_PERIOD_MS > 0)
+    /* Soak test: watch the heap over many OTA checks */
+    for( ;; )
+    {
+        vTaskDelay(pdMS_TO_TICKS(HEAP_REPORT_PERIOD_MS));
+        iot_pool_report();
+    }
+#else
     vTaskSuspend( NULL );
+#endif
  }
 
+/*******************************************************************************
+ * Function Name: wifi_task
+ *******************************************************************************
+ * Summary:
+ *  Short-lived task that brings up Wi-Fi in parallel with the initialization
+ *  done by ota_task(), reports the progress through wifi_events and exits.
+ *
+ * Parameters:
+ *  void *args : Task parameter defined during task creation (unused)
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void wifi_task(void *args)
+{
+    /* Connect to Wi-Fi AP. Transient failures are retried with backoff inside;
+     * only an invalid configuration makes it return. */
+    if( connect_to_wifi_ap() == CY_RSLT_SUCCESS )
+    {
+        xEventGroupSetBits(wifi_events, WIFI_EVENT_CONNECTED);
+    }
+    else
+    {
+        xEventGroupSetBits(wifi_events, WIFI_EVENT_STACK_READY | WIFI_EVENT_FAILED);
+    }
+
+    rtos_stats_stack_checkpoint();
+    vTaskDelete( NULL );
+}
+
 /*******************************************************************************
  * Function Name: connect_to_wifi_ap()
  *******************************************************************************
  * Summary:
- *  Connects to Wi-Fi AP using the user-configured credentials, retries up to a
- *  configured number of times until the connection succeeds.
+ *  Connects to Wi-Fi AP using the user-configured credentials, retries with a
+ *  backoff per failure class until the connection succeeds. When
+ *  ENABLE_WIFI_FAST_REJOIN is set, the AP parameters cached by the previous
+ *  boot are tried first. When ENABLE_NETWORK_LEASE_REUSE is set, the lease
+ *  saved before an OTA reboot replaces DHCP discovery.
  *
  *******************************************************************************/
 cy_rslt_t connect_to_wifi_ap(void)
 {
     cy_wcm_config_t wifi_config = { .interface = CY_WCM_INTERFACE_TYPE_STA};
     cy_wcm_connect_params_t wifi_conn_param;
-    cy_wcm_ip_address_t ip_address;
     cy_rslt_t result;
 
-    /* Variable to track the number of connection retries to the Wi-Fi AP specified
-     * by WIFI_SSID macro. */
-    uint32_t conn_retries = 0;
-
     /* Initialize Wi-Fi connection manager. */
+    app_trace_begin("Wi-Fi init");
     cy_wcm_init(&wifi_config);
+    app_trace_end("Wi-Fi init");
+    xEventGroupSetBits(wifi_events, WIFI_EVENT_STACK_READY);
 
      /* Set the Wi-Fi SSID, password and security type. */
     memset(&wifi_conn_param, 0, sizeof(cy_wcm_connect_params_t));
@@ -206,23 +487,11 @@ cy_rslt_t connect_to_wifi_ap(void)
     wifi_conn_param.ap_credentials.security = WIFI_SECURITY;
 
     /* Connect to the Wi-Fi AP */
-    for(conn_retries = 0; conn_retries < MAX_CONNECTION_RETRIES; conn_retries++)
-    {
-        result = cy_wcm_connect_ap( &wifi_conn_param, &ip_address );
-
-        if (result == CY_RSLT_SUCCESS)
-        {
-            printf( "Successfully connected to Wi-Fi network '%s'.\n",
-                    wifi_conn_param.ap_credentials.SSID);
-            return result;
-        }
-
-        printf( "Connection to Wi-Fi network failed with error code %d."
-                "Retrying in %d ms...\n", (int) result, WIFI_CONN_RETRY_DELAY_MS );
-        vTaskDelay(pdMS_TO_TICKS(WIFI_CONN_RETRY_DELAY_MS));
-    }
-
-    printf( "Exceeded maximum Wi-Fi connection attempts\n" );
+    app_trace_begin("Wi-Fi join and DHCP");
+    result = wifi_connect_ap(&wifi_conn_param,
+                             (ENABLE_WIFI_FAST_REJOIN ? WIFI_CONNECT_FLAG_FAST_REJOIN : 0u) |
+                             (ENABLE_NETWORK_LEASE_REUSE ? WIFI_CONNECT_FLAG_REUSE_LEASE : 0u));
+    app_trace_end("Wi-Fi join and DHCP");
 
     return result;
 }
@@ -231,9 +500,9 @@ cy_rslt_t connect_to_wifi_ap(void)
  * Function Name: ota_callback()
  *******************************************************************************
  * Summary:
- *  Print the status of the OTA agent on every event. This callback is optional,
- *  but be aware that the OTA middleware will not print the status of OTA agent
- *  on its own.
+ *  Print the status of the OTA agent on every event and show it on the user
+ *  LED. This callback is optional, but be aware that the OTA middleware will
+ *  not print the status of OTA agent on its own.
  *
  *******************************************************************************/
 void ota_callback(cy_ota_cb_reason_t reason, uint32_t value, void *cb_arg )
@@ -249,4 +518,96 @@ void ota_callback(cy_ota_cb_reason_t reason, uint32_t value, void *cb_arg )
             ota_state,
             cy_ota_get_state_string(ota_state),
             cy_ota_get_error_string(cy_ota_last_error()));
+
+    switch (ota_state)
+    {
+        case CY_OTA_STATE_CONNECTING:
+            status_led_set_state(STATUS_LED_CONNECTING);
+            break;
+        case CY_OTA_STATE_DOWNLOADING:
+            status_led_set_state(STATUS_LED_DOWNLOADING);
+            break;
+        case CY_OTA_STATE_VERIFYING:
+        case CY_OTA_STATE_OTA_COMPLETE:
+            status_led_set_state(STATUS_LED_VERIFYING);
+            break;
+        case CY_OTA_STATE_AGENT_WAITING:
+            status_led_set_state((cy_ota_last_error() == CY_RSLT_SUCCESS) ? STATUS_LED_IDLE : STATUS_LED_FAILED);
+#if (ENABLE_JITTER_BENCHMARK == true)
+            jitter_probe_report();
+#endif
+            break;
+        default:
+            break;
+    }
+    jitter_probe_phase(JITTER_PHASE_DOWNLOAD, (ota_state == CY_OTA_STATE_DOWNLOADING));
+    ota_throttle_set_active(ota_state == CY_OTA_STATE_DOWNLOADING);
+
+    if (ota_state == CY_OTA_STATE_OTA_COMPLETE)
+    {
+        /* Throughput and heap use of the download */
+        ota_tls_report_transfer();
+        ota_throttle_report();
+
+#if (ENABLE_OTA_CAROUSEL == true)
+        /* Tells the carousel publisher this device holds a verified image */
+        ota_carousel_complete();
+#endif
+
+        /* Stack use over the whole update cycle */
+        rtos_stats_stack_report();
+        iot_pool_report();
+#if (ENABLE_JITTER_BENCHMARK == true)
+        jitter_probe_report();
+#endif
+
+#if (ENABLE_DEFERRED_REBOOT == true)
+        /* The image is verified and the swap is pending; the application picks the time of the reboot */
+        ota_reboot_staged();
+#elif (ENABLE_NETWORK_LEASE_REUSE == true)
+        /* The agent reboots right after this state; keep the network configuration for the next boot */
+        wifi_connect_save_lease();
+#endif
+    }
+}
+
+/*******************************************************************************
+ * Function Name: update_staged_callback()
+ *******************************************************************************
+ * Summary:
+ *  Called by the deferred reboot once an update is staged. Stops the OTA agent,
+ *  so it does not download the update again, and schedules the reboot for when
+ *  the service has been idle for OTA_REBOOT_IDLE_MS. Pass a maintenance window
+ *  check to ota_reboot_when() to reboot only inside the window.
+ *
+ *******************************************************************************/
+void update_staged_callback(void *arg)
+{
+    if( cy_ota_agent_stop((cy_ota_context_ptr *)arg) != CY_RSLT_SUCCESS )
+    {
+        printf("\n Failed to stop the OTA agent.\n");
+    }
+
+    printf("Update staged, rebooting after %lu ms without a service response\n",
+           (unsigned long)OTA_REBOOT_IDLE_MS);
+    (void)ota_reboot_when(NULL, NULL, OTA_REBOOT_IDLE_MS, OTA_REBOOT_MAX_DEFER_MS);
+}
+
+/*******************************************************************************
+ * Function Name: update_reset_callback()
+ *******************************************************************************
+ * Summary:
+ *  Called by the deferred reboot right before the reset into the update. It
+ *  does not mark a service response: the downtime is measured from the last
+ *  mark of the application.
+ *
+ *******************************************************************************/
+void update_reset_callback(void *arg)
+{
+    (void)arg;
+
+#if (ENABLE_NETWORK_LEASE_REUSE == true)
+    /* Keep the network configuration for the next boot */
+    wifi_connect_save_lease();
+#endif
 }
@@ -0,0 +1,315 @@
+/******************************************************************************
+* File Name: ota_throttle.c
+*
+* Description: This file contains the OTA download throttle. At full speed the
+* OTA agent takes the image as fast as the broker sends it. In the background
+* mode, the download is held to a byte rate, a rate of flash writes and a CPU
+* share, so the application tasks keep their timing.
+*
+* MQTT 3.1.1 has no flow control of its own; the backpressure is TCP's. The
+* byte rate is held by pausing the socket reads while the agent downloads, so
+* the receive window of the connection fills up and the broker slows down,
+* and no data piles up on the device. This paces the whole MQTT connection:
+* keep-alive responses, SUBACKs and any application messages on it wait with
+* the chunks. The write rate and the CPU share are held by pausing after
+* every chunk written, in the thread of the OTA agent.
+*
+* Both pauses hook library calls with the --wrap option of the GNU linker:
+* cy_socket_recv() of the secure sockets library, which also feeds the byte
+* counter of conn_trace.c, and cy_ota_storage_write() of the OTA agent.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+
+/* FreeRTOS header files */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* OTA API */
+#include "cy_ota_api.h"
+
+/* Secure sockets API */
+#include "cy_secure_sockets.h"
+
+#include "conn_trace.h"
+#include "rtos_stats.h"
+#include "ota_carousel.h"
+#include "ota_throttle.h"
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+#if defined(OTA_THROTTLE_HOOKS)
+cy_rslt_t __real_cy_ota_storage_write(cy_ota_context_ptr ctx_ptr, cy_ota_storage_write_info_t *chunk_info);
+cy_rslt_t __real_cy_socket_recv(cy_socket_t handle, void *buffer, uint32_t length, int flags,
+                                uint32_t *bytes_received);
+#endif
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Limits in force; all 0 at full speed */
+static ota_throttle_params_t throttle_params;
+
+/* Set while the agent downloads; reads are only paced in the meantime */
+static volatile bool throttle_active;
+
+/* Next time a read or a write may start, per limit */
+static TickType_t throttle_rx_next;
+static TickType_t throttle_write_next;
+
+/* Bytes read but not yet paused for, below a millisecond at the rate */
+static uint32_t throttle_rx_pending;
+
+/* Size of the last chunk, to hold the byte rate to the write rate */
+static uint32_t throttle_chunk_size;
+
+/* Time spent waiting for each limit, in ms */
+static uint32_t throttle_wait_rx_ms;
+static uint32_t throttle_wait_write_ms;
+static uint32_t throttle_wait_cpu_ms;
+
+/*******************************************************************************
+ * Function Name: ota_throttle_wait_until
+ *******************************************************************************
+ * Summary:
+ *  Blocks the calling thread until a tick, and returns the time waited.
+ *
+ *******************************************************************************/
+static uint32_t ota_throttle_wait_until(TickType_t until)
+{
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = until - now;
+
+    /* Deadlines more than half the tick range away have passed already */
+    if ((wait == 0u) || (wait > (portMAX_DELAY / 2u)))
+    {
+        return 0u;
+    }
+
+    vTaskDelay(wait);
+    return (uint32_t)(wait * portTICK_PERIOD_MS);
+}
+
+/*******************************************************************************
+ * Function Name: ota_throttle_set
+ *******************************************************************************
+ * Summary:
+ *  Selects the background mode with the given limits, or full speed. Takes
+ *  effect on the next read or chunk. The CPU share limit needs the run-time
+ *  counter, and is dropped with a warning without it.
+ *
+ * Parameters:
+ *  const ota_throttle_params_t *params : Limits, or NULL for full speed
+ *
+ *******************************************************************************/
+void ota_throttle_set(const ota_throttle_params_t *params)
+{
+    ota_throttle_params_t full_speed = { 0u, 0u, 0u };
+
+    throttle_params = (params != NULL) ? *params : full_speed;
+
+    /* The time spent writing is measured with the run-time counter */
+    if ((throttle_params.max_cpu_permille > 0u) && !rtos_stats_timer_ready())
+    {
+        printf("OTA throttle: no run-time counter (build with RTOS_STATS=1), the CPU share limit is not applied\n");
+        throttle_params.max_cpu_permille = 0u;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: ota_throttle_set_active
+ *******************************************************************************
+ * Summary:
+ *  Tells whether the OTA agent is downloading. The socket reads are only
+ *  paced while it is, and then on the whole MQTT connection.
+ *
+ *******************************************************************************/
+void ota_throttle_set_active(bool active)
+{
+    if (active && !throttle_active)
+    {
+        throttle_rx_next = xTaskGetTickCount();
+        throttle_write_next = throttle_rx_next;
+        throttle_rx_pending = 0u;
+    }
+    throttle_active = active;
+}
+
+/*******************************************************************************
+ * Function Name: ota_throttle_rx
+ *******************************************************************************
+ * Summary:
+ *  Accounts the bytes of a socket read and pauses the reading thread as long
+ *  as the byte rate requires. The byte rate is also held to what the write
+ *  rate lets the agent store, so chunks do not queue up in memory.
+ *
+ * Parameters:
+ *  uint32_t bytes : Bytes returned by the read
+ *
+ *******************************************************************************/
+static void ota_throttle_rx(uint32_t bytes)
+{
+    uint32_t rate = throttle_params.max_bytes_per_sec;
+    uint32_t write_rate = throttle_params.max_writes_per_sec * throttle_chunk_size;
+    uint32_t pause_ms;
+
+    if (!throttle_active || (bytes == 0u))
+    {
+        return;
+    }
+
+    if ((write_rate > 0u) && ((rate == 0u) || (write_rate < rate)))
+    {
+        rate = write_rate;
+    }
+    if (rate == 0u)
+    {
+        return;
+    }
+
+    /* The bytes just read push the next read out by their share of a second;
+     * time left unused while the broker was slow is not saved up */
+    if ((TickType_t)(xTaskGetTickCount() - throttle_rx_next) < (portMAX_DELAY / 2u))
+    {
+        throttle_rx_next = xTaskGetTickCount();
+    }
+    throttle_rx_pending += bytes;
+    pause_ms = (uint32_t)(((uint64_t)throttle_rx_pending * 1000u) / rate);
+    throttle_rx_pending -= (uint32_t)(((uint64_t)pause_ms * rate) / 1000u);
+
+    throttle_rx_next += pdMS_TO_TICKS(pause_ms);
+    throttle_wait_rx_ms += ota_throttle_wait_until(throttle_rx_next);
+}
+
+/*******************************************************************************
+ * Function Name: ota_throttle_report
+ *******************************************************************************
+ * Summary:
+ *  Prints the time the download waited for each limit, and clears it.
+ *
+ *******************************************************************************/
+void ota_throttle_report(void)
+{
+    if ((throttle_params.max_bytes_per_sec == 0u) && (throttle_params.max_writes_per_sec == 0u) &&
+        (throttle_params.max_cpu_permille == 0u))
+    {
+        return;
+    }
+
+    printf("OTA throttle: waited %lu ms for the byte rate, %lu ms for the write rate, %lu ms for the CPU share\n",
+           (unsigned long)throttle_wait_rx_ms, (unsigned long)throttle_wait_write_ms,
+           (unsigned long)throttle_wait_cpu_ms);
+    throttle_wait_rx_ms = 0u;
+    throttle_wait_write_ms = 0u;
+    throttle_wait_cpu_ms = 0u;
+}
+
+#if defined(OTA_THROTTLE_HOOKS)
+/*******************************************************************************
+ * Function Name: __wrap_cy_ota_storage_write
+ *******************************************************************************
+ * Summary:
+ *  Replaces the chunk write of the OTA agent. Waits for the write rate before
+ *  the write, and after it pauses long enough for the time spent writing to
+ *  stay within the CPU share. The result of every write goes to the chunk
+ *  bitmap of the carousel mode.
+ *
+ *******************************************************************************/
+cy_rslt_t __wrap_cy_ota_storage_write(cy_ota_context_ptr ctx_ptr, cy_ota_storage_write_info_t *chunk_info)
+{
+    cy_rslt_t result;
+    uint32_t start_us;
+    uint32_t busy_us;
+    uint32_t permille = throttle_params.max_cpu_permille;
+
+    if (!throttle_active)
+    {
+        result = __real_cy_ota_storage_write(ctx_ptr, chunk_info);
+        ota_carousel_chunk_written(chunk_info->offset, (result == CY_RSLT_SUCCESS));
+        return result;
+    }
+
+    throttle_chunk_size = chunk_info->size;
+
+    if (throttle_params.max_writes_per_sec > 0u)
+    {
+        throttle_wait_write_ms += ota_throttle_wait_until(throttle_write_next);
+        throttle_write_next = xTaskGetTickCount() + pdMS_TO_TICKS(1000u / throttle_params.max_writes_per_sec);
+    }
+
+    start_us = rtos_stats_timer_read();
+    result = __real_cy_ota_storage_write(ctx_ptr, chunk_info);
+    busy_us = rtos_stats_timer_read() - start_us;
+    ota_carousel_chunk_written(chunk_info->offset, (result == CY_RSLT_SUCCESS));
+
+    if ((permille > 0u) && (permille < 1000u))
+    {
+        /* busy / (busy + pause) <= permille / 1000 */
+        throttle_wait_cpu_ms += ota_throttle_wait_until(xTaskGetTickCount() +
+                                    pdMS_TO_TICKS(((uint64_t)busy_us * (1000u - permille)) / (permille * 1000u)));
+    }
+
+    return result;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_cy_socket_recv
+ *******************************************************************************
+ * Summary:
+ *  Counts the bytes of every socket read for conn_trace.c and, while the
+ *  agent downloads in the background mode, pauses the reading thread for the
+ *  byte rate. The MQTT library reads every message of its connection here,
+ *  so the pause holds all of them, not only the chunks.
+ *
+ *******************************************************************************/
+cy_rslt_t __wrap_cy_socket_recv(cy_socket_t handle, void *buffer, uint32_t length, int flags,
+                                uint32_t *bytes_received)
+{
+    cy_rslt_t result = __real_cy_socket_recv(handle, buffer, length, flags, bytes_received);
+
+    if ((result == CY_RSLT_SUCCESS) && (bytes_received != NULL))
+    {
+        conn_trace_rx(*bytes_received);
+        ota_throttle_rx(*bytes_received);
+    }
+
+    return result;
+}
+#endif /* OTA_THROTTLE_HOOKS */
+
+/* [] END OF FILE */
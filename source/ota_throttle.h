@@ -1,7 +1,7 @@
 /******************************************************************************
-* File Name: led_task.c
+* File Name: ota_throttle.h
 *
-* Description: This file contains task and functions related to the LED task.
+* Description: This file contains declarations of the OTA download throttle.
 *
 *******************************************************************************
 * (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
@@ -35,52 +35,28 @@
 * indemnify Cypress against all liability.
 *******************************************************************************/
 
-/* Header file includes */
-#include "cyhal.h"
-#include "cybsp.h"
-#include "cy_retarget_io.h"
+#ifndef SOURCE_OTA_THROTTLE_H_
+#define SOURCE_OTA_THROTTLE_H_
 
-/* FreeRTOS header file */
-#include <FreeRTOS.h>
-#include <task.h>
-
-/**********************************************
- * Other configuration
- *********************************************/
-/* User LED blink delay */
-#define BLINKY_DELAY_MS     (1000)
+#include <stdbool.h>
+#include <stdint.h>
 
 /*******************************************************************************
- * Function Name: led_task
- *******************************************************************************
- * Summary:
- *  Task to initialize and toggle the user LED
- *
- * Parameters:
- *  void *args : Task parameter defined during task creation (unused)
- *
- * Return:
- *  void
- *
- *******************************************************************************/
-void led_task(void *args)
+* Data structures and enumerations
+********************************************************************************/
+/* Limits of the background download mode; 0 leaves a limit off */
+typedef struct
 {
-    cy_rslt_t result ;
-
-    /* Initialize the User LED */
-    result = cyhal_gpio_init(CYBSP_USER_LED, CYHAL_GPIO_DIR_OUTPUT,
-                            CYHAL_GPIO_DRIVE_PULLUP, CYBSP_LED_STATE_OFF);
-    CY_ASSERT(result == CY_RSLT_SUCCESS);
+    uint32_t max_bytes_per_sec;     /* Bytes received from the broker per second */
+    uint32_t max_writes_per_sec;    /* Chunks written to the upgrade slot per second */
+    uint32_t max_cpu_permille;      /* Share of the time spent writing chunks */
+} ota_throttle_params_t;
 
-    /* To avoid compiler warning */
-    (void)result;
-    
-    while( true )
-    {
-        /* Toggle the state of user LED */
-        cyhal_gpio_toggle(CYBSP_USER_LED);
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void ota_throttle_set(const ota_throttle_params_t *params);
+void ota_throttle_set_active(bool active);
+void ota_throttle_report(void);
 
-        /* Provide a delay between toggles */
-        vTaskDelay(pdMS_TO_TICKS(BLINKY_DELAY_MS));
-    }
-}
+#endif /* SOURCE_OTA_THROTTLE_H_ */
@@ -0,0 +1,603 @@
+/******************************************************************************
+* File Name: ota_tls.c
+*
+* Description: This file contains the TLS hooks of the OTA MQTT connection. The
+* secure sockets library owns the mbedTLS context, so the hooks wrap the mbedTLS
+* functions it calls, using the --wrap option of the GNU linker (see Makefile).
+* With other toolchains the hooks are compiled out and the connection uses the
+* library defaults.
+*
+* Session resumption: the session of the last successful handshake is cached
+* and offered on the next one, so reconnects and update checks can skip the
+* ECDHE key exchange and certificate verification. Both session IDs and
+* session tickets are supported.
+*
+* Record size: mbedTLS is built with record buffers of MBEDTLS_SSL_IN_CONTENT_LEN
+* bytes instead of 16 KB, and the matching Max Fragment Length (RFC 6066) is
+* requested from the broker so that it never sends a larger record.
+*
+* Tracing: every handshake step is marked in the phase ring of app_trace.
+*
+* Pre-shared key: when the build enables a PSK key exchange, the per-device
+* key and identity set by ota_tls_set_psk() are added to the configuration of
+* the connection, so the handshake needs no certificates.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <string.h>
+#include <malloc.h>
+
+/* FreeRTOS header file */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* mbedTLS header files */
+#include "mbedtls/ssl.h"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/md.h"
+
+#include "cy_ota_config.h"
+#include "app_nvm.h"
+#include "app_trace.h"
+#include "jitter_probe.h"
+#include "ota_tls.h"
+
+#if defined(OTA_TLS_HOOKS)
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Bump when the layout of ota_tls_session_t changes */
+#define OTA_TLS_SESSION_VERSION             (1u)
+
+/* Max Fragment Length matching the receive buffer of mbedTLS */
+#if (MBEDTLS_SSL_IN_CONTENT_LEN >= 16384)
+#define OTA_TLS_MFL_CODE                    MBEDTLS_SSL_MAX_FRAG_LEN_NONE
+#elif (MBEDTLS_SSL_IN_CONTENT_LEN == 4096)
+#define OTA_TLS_MFL_CODE                    MBEDTLS_SSL_MAX_FRAG_LEN_4096
+#elif (MBEDTLS_SSL_IN_CONTENT_LEN == 2048)
+#define OTA_TLS_MFL_CODE                    MBEDTLS_SSL_MAX_FRAG_LEN_2048
+#elif (MBEDTLS_SSL_IN_CONTENT_LEN == 1024)
+#define OTA_TLS_MFL_CODE                    MBEDTLS_SSL_MAX_FRAG_LEN_1024
+#else
+#error "MBEDTLS_SSL_IN_CONTENT_LEN must be 1024, 2048, 4096 or 16384"
+#endif
+
+#if (OTA_TLS_MFL_CODE != MBEDTLS_SSL_MAX_FRAG_LEN_NONE) && !defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+#error "A record buffer below 16 KB needs MBEDTLS_SSL_MAX_FRAGMENT_LENGTH"
+#endif
+
+/* Bytes around the image data in the MQTT PUBLISH of a chunk: the chunk
+ * header of the OTA agent, the fixed header, a topic of up to 64 bytes with
+ * its length, and the packet identifier */
+#define OTA_TLS_CHUNK_OVERHEAD              (32u + 5u + 2u + 64u + 2u)
+
+#if ((CY_OTA_CHUNK_SIZE + OTA_TLS_CHUNK_OVERHEAD) > MBEDTLS_SSL_IN_CONTENT_LEN)
+#error "A chunk does not fit in one TLS record: raise TLS_MAX_RECORD_LEN or lower CY_OTA_CHUNK_SIZE and the CHUNK_SIZE of the publisher"
+#endif
+
+/* PSK sizes: the key is an HMAC-SHA256; the identity is the prefix, a dash
+ * and the 16 hex digits of the device unique ID */
+#define OTA_TLS_PSK_LEN                     (32u)
+#define OTA_TLS_PSK_IDENTITY_MAX_LEN        (64u)
+
+/* A record at least this large starts the measured download window; smaller
+ * ones are MQTT control packets of an idle connection */
+#define OTA_TLS_TRANSFER_MIN_READ           (1024)
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* Resumable part of an mbedTLS session. The peer certificate is not kept; it
+ * is not needed to resume a session. */
+typedef struct
+{
+    uint32_t version;
+    uint32_t host_crc;
+    int32_t ciphersuite;
+    uint32_t verify_result;
+    uint32_t id_len;
+    uint8_t id[32];
+    uint8_t master[48];
+    uint32_t ticket_lifetime;
+    uint32_t ticket_len;
+    uint8_t ticket[OTA_TLS_MAX_TICKET_LEN];
+    uint8_t mfl_code;
+    uint8_t encrypt_then_mac;
+    uint8_t reserved[2];
+} ota_tls_session_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Phase names of the handshake steps, indexed by the state they complete */
+static const char * const ota_tls_step_names[] =
+{
+    [MBEDTLS_SSL_HELLO_REQUEST]                 = "tls start",
+    [MBEDTLS_SSL_CLIENT_HELLO]                  = "tls client hello",
+    [MBEDTLS_SSL_SERVER_HELLO]                  = "tls server hello",
+    [MBEDTLS_SSL_SERVER_CERTIFICATE]            = "tls server certificate",
+    [MBEDTLS_SSL_SERVER_KEY_EXCHANGE]           = "tls server key exchange",
+    [MBEDTLS_SSL_CERTIFICATE_REQUEST]           = "tls certificate request",
+    [MBEDTLS_SSL_SERVER_HELLO_DONE]             = "tls server hello done",
+    [MBEDTLS_SSL_CLIENT_CERTIFICATE]            = "tls client certificate",
+    [MBEDTLS_SSL_CLIENT_KEY_EXCHANGE]           = "tls client key exchange",
+    [MBEDTLS_SSL_CERTIFICATE_VERIFY]            = "tls certificate verify",
+    [MBEDTLS_SSL_CLIENT_CHANGE_CIPHER_SPEC]     = "tls client change cipher spec",
+    [MBEDTLS_SSL_CLIENT_FINISHED]               = "tls client finished",
+    [MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC]     = "tls server change cipher spec",
+    [MBEDTLS_SSL_SERVER_FINISHED]               = "tls server finished",
+    [MBEDTLS_SSL_FLUSH_BUFFERS]                 = "tls flush buffers",
+    [MBEDTLS_SSL_HANDSHAKE_WRAPUP]              = "tls handshake wrapup",
+    [MBEDTLS_SSL_SERVER_NEW_SESSION_TICKET]     = "tls new session ticket",
+};
+
+/* Only the MQTT connection uses TLS and the OTA agent opens one connection at a
+ * time, so a single cached session is enough and needs no locking. */
+static ota_tls_session_t ota_tls_session;
+static bool ota_tls_session_valid;
+static bool ota_tls_session_offered;
+static uint32_t ota_tls_flags;
+static TickType_t ota_tls_handshake_start;
+
+#if defined(OTA_TLS_PSK)
+/* Pre-shared key and identity of this device */
+static uint8_t ota_tls_psk[OTA_TLS_PSK_LEN];
+static char ota_tls_psk_identity[OTA_TLS_PSK_IDENTITY_MAX_LEN];
+static bool ota_tls_psk_valid;
+#endif
+
+/* Application data received since the download window started */
+static uint32_t ota_tls_rx_bytes;
+static TickType_t ota_tls_rx_start;
+static TickType_t ota_tls_rx_last;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+int __real_mbedtls_ssl_setup(mbedtls_ssl_context *ssl, const mbedtls_ssl_config *conf);
+int __real_mbedtls_ssl_read(mbedtls_ssl_context *ssl, unsigned char *buf, size_t len);
+
+/*******************************************************************************
+ * Function Name: ota_tls_host_crc
+ *******************************************************************************
+ * Summary:
+ *  Identifies the server of a connection by the host name used for SNI.
+ *
+ *******************************************************************************/
+static uint32_t ota_tls_host_crc(const mbedtls_ssl_context *ssl)
+{
+    return (ssl->hostname != NULL) ? app_nvm_crc32(ssl->hostname, strlen(ssl->hostname)) : 0u;
+}
+
+/*******************************************************************************
+ * Function Name: ota_tls_session_offer
+ *******************************************************************************
+ * Summary:
+ *  Offers the cached session in the ClientHello of a new handshake.
+ *
+ *******************************************************************************/
+static void ota_tls_session_offer(mbedtls_ssl_context *ssl)
+{
+    mbedtls_ssl_session session;
+
+    ota_tls_session_offered = false;
+
+    if (!ota_tls_session_valid || (ota_tls_session.host_crc != ota_tls_host_crc(ssl)))
+    {
+        return;
+    }
+
+    mbedtls_ssl_session_init(&session);
+    session.ciphersuite = ota_tls_session.ciphersuite;
+    session.verify_result = ota_tls_session.verify_result;
+    session.id_len = ota_tls_session.id_len;
+    memcpy(session.id, ota_tls_session.id, sizeof(session.id));
+    memcpy(session.master, ota_tls_session.master, sizeof(session.master));
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    /* mbedtls_ssl_set_session() copies the ticket */
+    session.ticket = (ota_tls_session.ticket_len > 0u) ? ota_tls_session.ticket : NULL;
+    session.ticket_len = ota_tls_session.ticket_len;
+    session.ticket_lifetime = ota_tls_session.ticket_lifetime;
+#endif
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    session.mfl_code = ota_tls_session.mfl_code;
+#endif
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+    session.encrypt_then_mac = ota_tls_session.encrypt_then_mac;
+#endif
+
+    ota_tls_session_offered = (mbedtls_ssl_set_session(ssl, &session) == 0);
+
+    /* The ticket belongs to the cache, so the session is wiped, not freed */
+    mbedtls_platform_zeroize(&session, sizeof(session));
+}
+
+/*******************************************************************************
+ * Function Name: ota_tls_session_store
+ *******************************************************************************
+ * Summary:
+ *  Caches the session of a completed handshake and reports whether the
+ *  handshake resumed the previous session.
+ *
+ *******************************************************************************/
+static void ota_tls_session_store(const mbedtls_ssl_context *ssl)
+{
+    const mbedtls_ssl_session *session = ssl->session;
+    bool resumed;
+
+    resumed = ota_tls_session_offered &&
+              (memcmp(ota_tls_session.master, session->master, sizeof(session->master)) == 0);
+
+    printf("TLS handshake with %s: %lu ms (%s)\n", (ssl->hostname != NULL) ? ssl->hostname : "server",
+           (unsigned long)((xTaskGetTickCount() - ota_tls_handshake_start) * portTICK_PERIOD_MS),
+           resumed ? "resumed" : "full");
+
+#if (OTA_TLS_MFL_CODE != MBEDTLS_SSL_MAX_FRAG_LEN_NONE)
+    if (session->mfl_code != OTA_TLS_MFL_CODE)
+    {
+        printf("WARNING: The broker ignored the Max Fragment Length request; records above %d bytes will fail.\n"
+               "         Build with TLS_MAX_RECORD_LEN=16384 for this broker.\n", MBEDTLS_SSL_IN_CONTENT_LEN);
+    }
+#endif
+
+    ota_tls_session.version = OTA_TLS_SESSION_VERSION;
+    ota_tls_session.host_crc = ota_tls_host_crc(ssl);
+    ota_tls_session.ciphersuite = session->ciphersuite;
+    ota_tls_session.verify_result = session->verify_result;
+    ota_tls_session.id_len = (uint32_t)session->id_len;
+    memcpy(ota_tls_session.id, session->id, sizeof(ota_tls_session.id));
+    memcpy(ota_tls_session.master, session->master, sizeof(ota_tls_session.master));
+    ota_tls_session.ticket_len = 0u;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    if ((session->ticket != NULL) && (session->ticket_len <= sizeof(ota_tls_session.ticket)))
+    {
+        memcpy(ota_tls_session.ticket, session->ticket, session->ticket_len);
+        ota_tls_session.ticket_len = (uint32_t)session->ticket_len;
+        ota_tls_session.ticket_lifetime = session->ticket_lifetime;
+    }
+#endif
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    ota_tls_session.mfl_code = session->mfl_code;
+#endif
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+    ota_tls_session.encrypt_then_mac = (uint8_t)session->encrypt_then_mac;
+#endif
+    ota_tls_session_valid = (ota_tls_session.id_len > 0u) || (ota_tls_session.ticket_len > 0u);
+
+    /* A resumed session has the same master secret, so only a full handshake
+     * needs a flash write */
+    if (!resumed && ota_tls_session_valid && ((ota_tls_flags & OTA_TLS_FLAG_PERSIST_SESSION) != 0u))
+    {
+        (void)app_nvm_write(APP_NVM_ID_TLS_SESSION, &ota_tls_session, sizeof(ota_tls_session));
+    }
+}
+
+/*******************************************************************************
+ * Function Name: ota_tls_session_drop
+ *******************************************************************************
+ * Summary:
+ *  Forgets the cached session after a failed handshake that offered it, so
+ *  that the next attempt uses a full handshake.
+ *
+ *******************************************************************************/
+static void ota_tls_session_drop(void)
+{
+    ota_tls_session_valid = false;
+    ota_tls_session_offered = false;
+    mbedtls_platform_zeroize(&ota_tls_session, sizeof(ota_tls_session));
+
+    if ((ota_tls_flags & OTA_TLS_FLAG_PERSIST_SESSION) != 0u)
+    {
+        (void)app_nvm_erase(APP_NVM_ID_TLS_SESSION);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: ota_tls_handshake_steps
+ *******************************************************************************
+ * Summary:
+ *  Same as mbedtls_ssl_handshake(), but marks the completion of every step in
+ *  the phase ring.
+ *
+ *******************************************************************************/
+static int ota_tls_handshake_steps(mbedtls_ssl_context *ssl)
+{
+    int ret = 0;
+    int state;
+
+    if ((ssl == NULL) || (ssl->conf == NULL))
+    {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+
+    while (ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER)
+    {
+        state = ssl->state;
+        ret = mbedtls_ssl_handshake_step(ssl);
+
+        if ((ssl->state != state) && (state >= 0) &&
+            ((size_t)state < (sizeof(ota_tls_step_names) / sizeof(ota_tls_step_names[0]))) &&
+            (ota_tls_step_names[state] != NULL))
+        {
+            app_trace_mark(ota_tls_step_names[state]);
+        }
+
+        if (ret != 0)
+        {
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_mbedtls_ssl_handshake
+ *******************************************************************************
+ * Summary:
+ *  Replaces mbedtls_ssl_handshake() for the secure sockets library. Offers the
+ *  cached session when a handshake starts, traces every step, and caches the
+ *  session when it completes.
+ *
+ *******************************************************************************/
+int __wrap_mbedtls_ssl_handshake(mbedtls_ssl_context *ssl)
+{
+    int ret;
+    bool is_client = (ssl != NULL) && (ssl->conf != NULL) && (ssl->conf->endpoint == MBEDTLS_SSL_IS_CLIENT);
+
+    if (is_client && (ssl->state == MBEDTLS_SSL_HELLO_REQUEST))
+    {
+        ota_tls_handshake_start = xTaskGetTickCount();
+        ota_tls_session_offer(ssl);
+    }
+
+    jitter_probe_phase(JITTER_PHASE_HANDSHAKE, true);
+    ret = ota_tls_handshake_steps(ssl);
+    jitter_probe_phase(JITTER_PHASE_HANDSHAKE, false);
+
+    if (is_client)
+    {
+        if (ret == 0)
+        {
+            ota_tls_session_store(ssl);
+        }
+        else if ((ret != MBEDTLS_ERR_SSL_WANT_READ) && (ret != MBEDTLS_ERR_SSL_WANT_WRITE) &&
+                 ota_tls_session_offered)
+        {
+            ota_tls_session_drop();
+        }
+    }
+
+    return ret;
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_mbedtls_ssl_setup
+ *******************************************************************************
+ * Summary:
+ *  Replaces mbedtls_ssl_setup() for the secure sockets library. Requests the
+ *  Max Fragment Length that matches the record buffers before the context
+ *  allocates them. The configuration belongs to the secure sockets library,
+ *  which does not change it after setup.
+ *
+ *******************************************************************************/
+int __wrap_mbedtls_ssl_setup(mbedtls_ssl_context *ssl, const mbedtls_ssl_config *conf)
+{
+#if (OTA_TLS_MFL_CODE != MBEDTLS_SSL_MAX_FRAG_LEN_NONE)
+    if (conf->endpoint == MBEDTLS_SSL_IS_CLIENT)
+    {
+        (void)mbedtls_ssl_conf_max_frag_len((mbedtls_ssl_config *)conf, OTA_TLS_MFL_CODE);
+    }
+#endif
+
+#if defined(OTA_TLS_PSK)
+    if ((conf->endpoint == MBEDTLS_SSL_IS_CLIENT) && ota_tls_psk_valid)
+    {
+        if (mbedtls_ssl_conf_psk((mbedtls_ssl_config *)conf, ota_tls_psk, sizeof(ota_tls_psk),
+                                 (const unsigned char *)ota_tls_psk_identity, strlen(ota_tls_psk_identity)) != 0)
+        {
+            printf("Failed to configure the TLS pre-shared key\n");
+        }
+    }
+#endif
+
+    return __real_mbedtls_ssl_setup(ssl, conf);
+}
+
+/*******************************************************************************
+ * Function Name: __wrap_mbedtls_ssl_read
+ *******************************************************************************
+ * Summary:
+ *  Replaces mbedtls_ssl_read() for the secure sockets library. Counts the
+ *  application data of the download for ota_tls_report_transfer().
+ *
+ *******************************************************************************/
+int __wrap_mbedtls_ssl_read(mbedtls_ssl_context *ssl, unsigned char *buf, size_t len)
+{
+    int ret = __real_mbedtls_ssl_read(ssl, buf, len);
+
+    if (ret > 0)
+    {
+        if ((ota_tls_rx_bytes == 0u) && (ret >= OTA_TLS_TRANSFER_MIN_READ))
+        {
+            ota_tls_rx_start = xTaskGetTickCount();
+        }
+        if ((ota_tls_rx_bytes > 0u) || (ret >= OTA_TLS_TRANSFER_MIN_READ))
+        {
+            ota_tls_rx_bytes += (uint32_t)ret;
+            ota_tls_rx_last = xTaskGetTickCount();
+        }
+    }
+
+    return ret;
+}
+
+#endif /* OTA_TLS_HOOKS */
+
+/*******************************************************************************
+ * Function Name: ota_tls_set_psk
+ *******************************************************************************
+ * Summary:
+ *  Sets the pre-shared key of the connection. The identity is the prefix
+ *  followed by the unique ID of the device, and the key is derived from the
+ *  fleet key as HMAC-SHA256(fleet key, identity), so that every device has its
+ *  own key while only the fleet key is configured. scripts/psk_provision.py
+ *  computes the same key for the broker.
+ *
+ * Parameters:
+ *  const char *fleet_key_hex : Fleet key as a hex string
+ *  const char *prefix        : Identity prefix, e.g. the MQTT client identifier
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, OTA_TLS_RSLT_ERR_BAD_ARG for an invalid key, or
+ *              OTA_TLS_RSLT_ERR_UNSUPPORTED if the build has no PSK key exchange
+ *
+ *******************************************************************************/
+cy_rslt_t ota_tls_set_psk(const char *fleet_key_hex, const char *prefix)
+{
+#if defined(OTA_TLS_HOOKS) && defined(OTA_TLS_PSK)
+    uint8_t fleet_key[OTA_TLS_PSK_LEN];
+    size_t key_len = strlen(fleet_key_hex);
+    uint64_t unique_id = Cy_SysLib_GetUniqueId();
+    unsigned int byte;
+    int len;
+
+    if ((key_len == 0u) || ((key_len % 2u) != 0u) || ((key_len / 2u) > sizeof(fleet_key)))
+    {
+        return OTA_TLS_RSLT_ERR_BAD_ARG;
+    }
+    for (size_t i = 0; i < (key_len / 2u); i++)
+    {
+        if (sscanf(&fleet_key_hex[i * 2u], "%2x", &byte) != 1)
+        {
+            return OTA_TLS_RSLT_ERR_BAD_ARG;
+        }
+        fleet_key[i] = (uint8_t)byte;
+    }
+
+    len = snprintf(ota_tls_psk_identity, sizeof(ota_tls_psk_identity), "%s-%08lx%08lx", prefix,
+                   (unsigned long)(unique_id >> 32), (unsigned long)(unique_id & 0xFFFFFFFFu));
+    if ((len < 0) || ((size_t)len >= sizeof(ota_tls_psk_identity)))
+    {
+        return OTA_TLS_RSLT_ERR_BAD_ARG;
+    }
+
+    ota_tls_psk_valid = (mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), fleet_key, key_len / 2u,
+                                         (const unsigned char *)ota_tls_psk_identity, (size_t)len,
+                                         ota_tls_psk) == 0);
+    mbedtls_platform_zeroize(fleet_key, sizeof(fleet_key));
+
+    if (!ota_tls_psk_valid)
+    {
+        return OTA_TLS_RSLT_ERR_BAD_ARG;
+    }
+
+    printf("TLS PSK identity: %s\n", ota_tls_psk_identity);
+    return CY_RSLT_SUCCESS;
+#else
+    (void)fleet_key_hex;
+    (void)prefix;
+    return OTA_TLS_RSLT_ERR_UNSUPPORTED;
+#endif
+}
+
+/*******************************************************************************
+ * Function Name: ota_tls_report_transfer
+ *******************************************************************************
+ * Summary:
+ *  Prints the throughput of the download received over TLS and the heap
+ *  high-water mark, then starts a new measurement. Called when a download
+ *  completes.
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void ota_tls_report_transfer(void)
+{
+    /* heap_3 uses the C library allocator, whose arena only grows */
+    struct mallinfo heap = mallinfo();
+
+#if defined(OTA_TLS_HOOKS)
+    uint32_t elapsed_ms = (uint32_t)((ota_tls_rx_last - ota_tls_rx_start) * portTICK_PERIOD_MS);
+
+    if (ota_tls_rx_bytes > 0u)
+    {
+        printf("TLS download: %lu bytes in %lu ms (%lu bytes/s), record buffers %d/%d bytes\n",
+               (unsigned long)ota_tls_rx_bytes, (unsigned long)elapsed_ms,
+               (unsigned long)((elapsed_ms > 0u) ? (((uint64_t)ota_tls_rx_bytes * 1000u) / elapsed_ms) : 0u),
+               MBEDTLS_SSL_IN_CONTENT_LEN, MBEDTLS_SSL_OUT_CONTENT_LEN);
+    }
+    ota_tls_rx_bytes = 0u;
+#endif
+
+    printf("Heap high-water mark: %lu bytes\n", (unsigned long)heap.arena);
+}
+
+/*******************************************************************************
+ * Function Name: ota_tls_init
+ *******************************************************************************
+ * Summary:
+ *  Configures the TLS hooks of the OTA MQTT connection. Must be called before
+ *  the OTA agent is started. Loads the session saved by the previous boot when
+ *  OTA_TLS_FLAG_PERSIST_SESSION is set.
+ *
+ * Parameters:
+ *  uint32_t flags : OTA_TLS_FLAG_* values
+ *
+ * Return:
+ *  void
+ *
+ *******************************************************************************/
+void ota_tls_init(uint32_t flags)
+{
+#if defined(OTA_TLS_HOOKS)
+    ota_tls_flags = flags;
+
+    if (((flags & OTA_TLS_FLAG_PERSIST_SESSION) != 0u) && (app_nvm_init() == CY_RSLT_SUCCESS) &&
+        (app_nvm_read(APP_NVM_ID_TLS_SESSION, &ota_tls_session, sizeof(ota_tls_session)) == CY_RSLT_SUCCESS))
+    {
+        ota_tls_session_valid = (ota_tls_session.version == OTA_TLS_SESSION_VERSION);
+    }
+#else
+    (void)flags;
+    printf("TLS hooks are only supported with GCC_ARM; session resumption is disabled.\n");
+#endif
+}
+
+/* [] END OF FILE */
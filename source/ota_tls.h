@@ -0,0 +1,69 @@
+/******************************************************************************
+* File Name: ota_tls.h
+*
+* Description: This file contains declarations of the TLS hooks of the OTA MQTT
+* connection.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_OTA_TLS_H_
+#define SOURCE_OTA_TLS_H_
+
+#include <stdint.h>
+#include "cy_result.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Result codes */
+#define OTA_TLS_RSLT_MODULE                 (CY_RSLT_MODULE_MIDDLEWARE_BASE + 0xF2u)
+#define OTA_TLS_RSLT_ERR_BAD_ARG            CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, OTA_TLS_RSLT_MODULE, 1)
+#define OTA_TLS_RSLT_ERR_UNSUPPORTED        CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, OTA_TLS_RSLT_MODULE, 2)
+
+/* Flags of ota_tls_init() */
+#define OTA_TLS_FLAG_PERSIST_SESSION        (1u << 0)   /* Keep the TLS session in flash across reboots */
+
+/* Largest session ticket that is cached. Longer tickets are dropped and only
+ * the session ID is used for resumption. */
+#ifndef OTA_TLS_MAX_TICKET_LEN
+#define OTA_TLS_MAX_TICKET_LEN              (256u)
+#endif
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void ota_tls_init(uint32_t flags);
+cy_rslt_t ota_tls_set_psk(const char *fleet_key_hex, const char *prefix);
+void ota_tls_report_transfer(void);
+
+#endif /* SOURCE_OTA_TLS_H_ */
@@ -0,0 +1,597 @@
+/******************************************************************************
+* File Name: rtos_stats.c
+*
+* Description: This file contains the FreeRTOS run-time statistics. A 1 MHz
+* hardware timer backs the run-time counter of FreeRTOS, and a low priority
+* task samples the counters of every task periodically and publishes the CPU
+* share of each task in the period on a telemetry topic. The message is
+* decoded by scripts/rtos_stats_viewer.py.
+*
+* Message layout, little endian:
+*   char     magic[3]        "RTS"
+*   uint8_t  version         RTOS_STATS_MSG_VERSION
+*   uint32_t uptime_ms       End of the period
+*   uint32_t period_us       Run-time counter ticks in the period
+*   uint8_t  task_count
+*   task_count times:
+*     uint8_t  task_number   FreeRTOS task number, stable for the task's life
+*     uint8_t  priority
+*     uint16_t cpu_permille  CPU share of the task in the period
+*     uint16_t stack_free    Stack high-water mark, in words
+*     uint8_t  name_len
+*     char     name[name_len]
+*
+* The hardware timer stops in deep sleep, so time spent there is not counted
+* and the shares are of the time the CPU was awake. The timer and the sampling
+* task only run in builds with RTOS_STATS=1 (ENABLE_RTOS_STATS).
+*
+* Every sample also keeps the lowest stack high-water mark seen per task name,
+* so the worst case of a whole OTA cycle survives tasks that come and go.
+* rtos_stats_stack_report() takes a sample of its own and turns the marks
+* into recommended stack sizes for the tasks whose size was registered with
+* rtos_stats_stack_register(); it works without the sampling task.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <string.h>
+
+/* FreeRTOS header files */
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "conn_trace.h"
+#include "rtos_stats.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+#define RTOS_STATS_TASK_STACK_SIZE          (1024)
+#define RTOS_STATS_TASK_PRIORITY            (tskIDLE_PRIORITY + 1)
+
+/* Loaded into the counter before it starts; a 16-bit counter reads it back
+ * truncated */
+#define RTOS_STATS_TIMER_WIDTH_CHECK        (0x10000u)
+
+/* Largest message: header and every task with a full-length name */
+#define RTOS_STATS_HEADER_SIZE              (13u)
+#define RTOS_STATS_ENTRY_SIZE               (7u + configMAX_TASK_NAME_LEN)
+#define RTOS_STATS_MSG_MAX_SIZE             (RTOS_STATS_HEADER_SIZE + (RTOS_STATS_MAX_TASKS * RTOS_STATS_ENTRY_SIZE))
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* Run-time counter of a task at the previous sample */
+typedef struct
+{
+    UBaseType_t task_number;
+    uint32_t run_time;
+} rtos_stats_prev_t;
+
+/* Worst stack use of a task name */
+typedef struct
+{
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t size_words;                /* 0 when not registered */
+    uint32_t min_free_words;            /* UINT32_MAX until sampled */
+} rtos_stats_stack_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+static cyhal_timer_t stats_timer;
+static bool stats_timer_ready;
+
+/* Why the run-time counter is not running, reported by rtos_stats_start() */
+static cy_rslt_t stats_timer_error;
+static bool stats_timer_narrow;
+
+static const char *stats_topic;
+static uint32_t stats_period_ms;
+
+/* Sampling buffers, only used by the sampling task */
+static TaskStatus_t stats_tasks[RTOS_STATS_MAX_TASKS];
+static rtos_stats_prev_t stats_prev[RTOS_STATS_MAX_TASKS];
+static uint32_t stats_prev_count;
+static uint32_t stats_prev_total;
+static uint8_t stats_msg[RTOS_STATS_MSG_MAX_SIZE];
+
+/* Stack sizing table, updated from any task inside a critical section */
+static rtos_stats_stack_t stats_stacks[RTOS_STATS_MAX_STACKS];
+static uint32_t stats_stack_count;
+
+/*******************************************************************************
+ * Function Name: rtos_stats_timer_init
+ *******************************************************************************
+ * Summary:
+ *  Starts the free-running 1 MHz timer of the run-time counter. Called by
+ *  FreeRTOS through portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() when the
+ *  scheduler starts. The counter must be 32 bits wide: a 16-bit counter wraps
+ *  every 65 ms, which the per-task counters of FreeRTOS cannot tell apart.
+ *  Without a timer, or with a 16-bit one, the counter stays at 0 and the
+ *  statistics are disabled.
+ *
+ *******************************************************************************/
+void rtos_stats_timer_init(void)
+{
+    cyhal_timer_cfg_t timer_cfg =
+    {
+        .compare_value = 0,
+        .period = UINT32_MAX,
+        .direction = CYHAL_TIMER_DIR_UP,
+        .is_compare = false,
+        .is_continuous = true,
+        .value = RTOS_STATS_TIMER_WIDTH_CHECK
+    };
+
+    stats_timer_error = cyhal_timer_init(&stats_timer, NC, NULL);
+    if (stats_timer_error != CY_RSLT_SUCCESS)
+    {
+        return;
+    }
+
+    stats_timer_error = cyhal_timer_configure(&stats_timer, &timer_cfg);
+    if ((stats_timer_error == CY_RSLT_SUCCESS) && (cyhal_timer_read(&stats_timer) < RTOS_STATS_TIMER_WIDTH_CHECK))
+    {
+        stats_timer_narrow = true;
+        stats_timer_error = RTOS_STATS_RSLT_ERR_TIMER;
+    }
+
+    timer_cfg.value = 0;
+    if (stats_timer_error == CY_RSLT_SUCCESS)
+    {
+        stats_timer_error = cyhal_timer_configure(&stats_timer, &timer_cfg);
+    }
+    if (stats_timer_error == CY_RSLT_SUCCESS)
+    {
+        stats_timer_error = cyhal_timer_set_frequency(&stats_timer, RTOS_STATS_TIMER_HZ);
+    }
+    if (stats_timer_error == CY_RSLT_SUCCESS)
+    {
+        stats_timer_error = cyhal_timer_start(&stats_timer);
+    }
+
+    if (stats_timer_error == CY_RSLT_SUCCESS)
+    {
+        stats_timer_ready = true;
+    }
+    else
+    {
+        cyhal_timer_free(&stats_timer);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_timer_read
+ *******************************************************************************
+ * Summary:
+ *  Returns the run-time counter. Called by FreeRTOS through
+ *  portGET_RUN_TIME_COUNTER_VALUE() on every context switch.
+ *
+ *******************************************************************************/
+uint32_t rtos_stats_timer_read(void)
+{
+    return stats_timer_ready ? cyhal_timer_read(&stats_timer) : 0u;
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_timer_ready
+ *******************************************************************************
+ * Summary:
+ *  Tells whether the run-time counter runs. Measurements built on
+ *  rtos_stats_timer_read() must check it first.
+ *
+ *******************************************************************************/
+bool rtos_stats_timer_ready(void)
+{
+    return stats_timer_ready;
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_put_u16
+ *******************************************************************************
+ * Summary:
+ *  Writes a little endian 16-bit value and returns the next write position.
+ *
+ *******************************************************************************/
+static uint8_t *rtos_stats_put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_put_u32
+ *******************************************************************************
+ * Summary:
+ *  Writes a little endian 32-bit value and returns the next write position.
+ *
+ *******************************************************************************/
+static uint8_t *rtos_stats_put_u32(uint8_t *p, uint32_t value)
+{
+    p = rtos_stats_put_u16(p, (uint16_t)value);
+    return rtos_stats_put_u16(p, (uint16_t)(value >> 16));
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_prev_run_time
+ *******************************************************************************
+ * Summary:
+ *  Returns the run-time counter of a task at the previous sample, or the
+ *  counter of the period start for a task created since then.
+ *
+ *******************************************************************************/
+static uint32_t rtos_stats_prev_run_time(UBaseType_t task_number)
+{
+    for (uint32_t i = 0; i < stats_prev_count; i++)
+    {
+        if (stats_prev[i].task_number == task_number)
+        {
+            return stats_prev[i].run_time;
+        }
+    }
+    return 0u;
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_stack_find
+ *******************************************************************************
+ * Summary:
+ *  Returns the stack sizing entry of a task name, adding it if needed. Must be
+ *  called inside a critical section.
+ *
+ * Return:
+ *  rtos_stats_stack_t * : Entry, or NULL when the table is full
+ *
+ *******************************************************************************/
+static rtos_stats_stack_t *rtos_stats_stack_find(const char *task_name)
+{
+    rtos_stats_stack_t *entry;
+
+    for (uint32_t i = 0; i < stats_stack_count; i++)
+    {
+        if (strncmp(stats_stacks[i].name, task_name, configMAX_TASK_NAME_LEN) == 0)
+        {
+            return &stats_stacks[i];
+        }
+    }
+
+    if (stats_stack_count >= RTOS_STATS_MAX_STACKS)
+    {
+        return NULL;
+    }
+
+    entry = &stats_stacks[stats_stack_count++];
+    strncpy(entry->name, task_name, configMAX_TASK_NAME_LEN - 1);
+    entry->size_words = 0u;
+    entry->min_free_words = UINT32_MAX;
+    return entry;
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_stack_update
+ *******************************************************************************
+ * Summary:
+ *  Keeps the lowest stack high-water mark seen for a task name.
+ *
+ *******************************************************************************/
+static void rtos_stats_stack_update(const char *task_name, uint32_t free_words)
+{
+    rtos_stats_stack_t *entry;
+
+    taskENTER_CRITICAL();
+    entry = rtos_stats_stack_find(task_name);
+    if ((entry != NULL) && (free_words < entry->min_free_words))
+    {
+        entry->min_free_words = free_words;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_stack_sample
+ *******************************************************************************
+ * Summary:
+ *  Records the stack high-water mark of every task. Uses a buffer of its own,
+ *  so it can run alongside the sampling task.
+ *
+ *******************************************************************************/
+static void rtos_stats_stack_sample(void)
+{
+    TaskStatus_t *tasks;
+    UBaseType_t count;
+
+    /* Room for a few tasks created in the meantime */
+    count = uxTaskGetNumberOfTasks() + 2u;
+    tasks = pvPortMalloc(count * sizeof(TaskStatus_t));
+    if (tasks == NULL)
+    {
+        return;
+    }
+
+    count = uxTaskGetSystemState(tasks, count, NULL);
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        rtos_stats_stack_update(tasks[i].pcTaskName, tasks[i].usStackHighWaterMark);
+    }
+
+    vPortFree(tasks);
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_sample
+ *******************************************************************************
+ * Summary:
+ *  Samples the counters of every task and encodes the shares of the period in
+ *  stats_msg. The per-task counters wrap around after about an hour, so only
+ *  differences between samples are used.
+ *
+ * Return:
+ *  size_t : Length of the message
+ *
+ *******************************************************************************/
+static size_t rtos_stats_sample(void)
+{
+    uint32_t total;
+    uint32_t period;
+    uint32_t delta;
+    UBaseType_t count;
+    size_t name_len;
+    uint8_t *p = stats_msg;
+
+    count = uxTaskGetSystemState(stats_tasks, RTOS_STATS_MAX_TASKS, &total);
+    if (count == 0u)
+    {
+        /* More tasks than RTOS_STATS_MAX_TASKS */
+        return 0u;
+    }
+    period = total - stats_prev_total;
+
+    memcpy(p, "RTS", 3u);
+    p += 3;
+    *p++ = RTOS_STATS_MSG_VERSION;
+    p = rtos_stats_put_u32(p, (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS));
+    p = rtos_stats_put_u32(p, period);
+    *p++ = (uint8_t)count;
+
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        delta = stats_tasks[i].ulRunTimeCounter - rtos_stats_prev_run_time(stats_tasks[i].xTaskNumber);
+        name_len = strnlen(stats_tasks[i].pcTaskName, configMAX_TASK_NAME_LEN);
+
+        *p++ = (uint8_t)stats_tasks[i].xTaskNumber;
+        *p++ = (uint8_t)stats_tasks[i].uxCurrentPriority;
+        p = rtos_stats_put_u16(p, (uint16_t)((period > 0u) ? (((uint64_t)delta * 1000u) / period) : 0u));
+        p = rtos_stats_put_u16(p, (uint16_t)stats_tasks[i].usStackHighWaterMark);
+        *p++ = (uint8_t)name_len;
+        memcpy(p, stats_tasks[i].pcTaskName, name_len);
+        p += name_len;
+
+        rtos_stats_stack_update(stats_tasks[i].pcTaskName, stats_tasks[i].usStackHighWaterMark);
+    }
+
+    for (UBaseType_t i = 0; i < count; i++)
+    {
+        stats_prev[i].task_number = stats_tasks[i].xTaskNumber;
+        stats_prev[i].run_time = stats_tasks[i].ulRunTimeCounter;
+    }
+    stats_prev_count = count;
+    stats_prev_total = total;
+
+    return (size_t)(p - stats_msg);
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_task
+ *******************************************************************************
+ * Summary:
+ *  Samples the run-time statistics every period and publishes them while the
+ *  OTA agent is connected to the broker, if a topic was given.
+ *
+ *******************************************************************************/
+static void rtos_stats_task(void *args)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+    size_t length;
+
+    (void)args;
+
+    for (;;)
+    {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(stats_period_ms));
+
+        length = rtos_stats_sample();
+        if ((length > 0u) && (stats_topic != NULL))
+        {
+            (void)conn_trace_publish(stats_topic, stats_msg, length);
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_start
+ *******************************************************************************
+ * Summary:
+ *  Starts sampling the run-time statistics and publishing them on a topic.
+ *  Samples taken while the OTA agent is not connected are dropped. Without a
+ *  run-time counter, the CPU shares would all read 0: the error is printed,
+ *  nothing is published, and the samples only feed the stack sizing report.
+ *
+ * Parameters:
+ *  const char *topic  : Telemetry topic; must stay valid. NULL only feeds the
+ *                       stack sizing report.
+ *  uint32_t period_ms : Sampling period
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, RTOS_STATS_RSLT_ERR_TIMER (sampling stacks
+ *              only), or RTOS_STATS_RSLT_ERR_NOMEM
+ *
+ *******************************************************************************/
+cy_rslt_t rtos_stats_start(const char *topic, uint32_t period_ms)
+{
+    stats_topic = stats_timer_ready ? topic : NULL;
+    stats_period_ms = period_ms;
+
+    if (!stats_timer_ready)
+    {
+        if (stats_timer_narrow)
+        {
+            printf("Run-time statistics disabled: the timer of the run-time counter is 16 bits wide\n");
+        }
+        else
+        {
+            printf("Run-time statistics disabled: no run-time counter timer, error 0x%08lx\n",
+                   (unsigned long)stats_timer_error);
+        }
+    }
+
+    rtos_stats_stack_register("STATS TASK", RTOS_STATS_TASK_STACK_SIZE);
+
+    if (xTaskCreate(rtos_stats_task, "STATS TASK", RTOS_STATS_TASK_STACK_SIZE, NULL,
+                    RTOS_STATS_TASK_PRIORITY, NULL) != pdPASS)
+    {
+        return RTOS_STATS_RSLT_ERR_NOMEM;
+    }
+
+    return stats_timer_ready ? CY_RSLT_SUCCESS : RTOS_STATS_RSLT_ERR_TIMER;
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_stack_register
+ *******************************************************************************
+ * Summary:
+ *  Records the stack size a task is created with, so the report can show its
+ *  peak use and a recommended size. FreeRTOS does not keep the size itself.
+ *
+ * Parameters:
+ *  const char *task_name : Task name as given to xTaskCreate()
+ *  uint32_t stack_words  : Stack depth as given to xTaskCreate(), in words
+ *
+ *******************************************************************************/
+void rtos_stats_stack_register(const char *task_name, uint32_t stack_words)
+{
+    rtos_stats_stack_t *entry;
+
+    taskENTER_CRITICAL();
+    entry = rtos_stats_stack_find(task_name);
+    if (entry != NULL)
+    {
+        entry->size_words = stack_words;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_stack_checkpoint
+ *******************************************************************************
+ * Summary:
+ *  Records the stack high-water mark of the calling task. Short-lived tasks
+ *  call it before deleting themselves, as they may never be sampled.
+ *
+ *******************************************************************************/
+void rtos_stats_stack_checkpoint(void)
+{
+    rtos_stats_stack_update(pcTaskGetName(NULL), (uint32_t)uxTaskGetStackHighWaterMark(NULL));
+}
+
+/*******************************************************************************
+ * Function Name: rtos_stats_stack_report
+ *******************************************************************************
+ * Summary:
+ *  Samples every task, then prints the worst stack use of every task seen
+ *  since boot and a recommended size: the peak plus
+ *  RTOS_STATS_STACK_MARGIN_PCT of it, at least RTOS_STATS_STACK_MIN_MARGIN
+ *  bytes, rounded up to RTOS_STATS_STACK_ALIGN. For tasks of unknown size,
+ *  the amount the stack can shrink by is shown as a negative number instead.
+ *  All values are in bytes.
+ *
+ *******************************************************************************/
+void rtos_stats_stack_report(void)
+{
+    const rtos_stats_stack_t *entry;
+    uint32_t size;
+    uint32_t free_bytes;
+    uint32_t peak;
+    uint32_t margin;
+    uint32_t shrink;
+    char shrink_text[12];
+
+    rtos_stats_stack_register("IDLE", configMINIMAL_STACK_SIZE);
+#if (configUSE_TIMERS == 1)
+    rtos_stats_stack_register(configTIMER_SERVICE_TASK_NAME, configTIMER_TASK_STACK_DEPTH);
+#endif
+    rtos_stats_stack_sample();
+
+    printf("\nStack sizing, worst case since boot (bytes, margin %u%%):\n",
+           (unsigned int)RTOS_STATS_STACK_MARGIN_PCT);
+    printf("  %-16s %7s %7s %7s %11s\n", "TASK", "SIZE", "PEAK", "FREE", "RECOMMENDED");
+
+    for (uint32_t i = 0; i < stats_stack_count; i++)
+    {
+        entry = &stats_stacks[i];
+        if (entry->min_free_words == UINT32_MAX)
+        {
+            /* Registered but never seen running */
+            continue;
+        }
+        free_bytes = entry->min_free_words * sizeof(StackType_t);
+
+        if (entry->size_words > 0u)
+        {
+            size = entry->size_words * sizeof(StackType_t);
+            peak = (size > free_bytes) ? (size - free_bytes) : 0u;
+            margin = (peak * RTOS_STATS_STACK_MARGIN_PCT) / 100u;
+            if (margin < RTOS_STATS_STACK_MIN_MARGIN)
+            {
+                margin = RTOS_STATS_STACK_MIN_MARGIN;
+            }
+            printf("  %-16s %7lu %7lu %7lu %11lu\n", entry->name,
+                   (unsigned long)size, (unsigned long)peak, (unsigned long)free_bytes,
+                   (unsigned long)(((peak + margin + RTOS_STATS_STACK_ALIGN - 1u) / RTOS_STATS_STACK_ALIGN) * RTOS_STATS_STACK_ALIGN));
+        }
+        else
+        {
+            shrink = (free_bytes > RTOS_STATS_STACK_MIN_MARGIN) ? (free_bytes - RTOS_STATS_STACK_MIN_MARGIN) : 0u;
+            shrink = (shrink / RTOS_STATS_STACK_ALIGN) * RTOS_STATS_STACK_ALIGN;
+            snprintf(shrink_text, sizeof(shrink_text), "-%lu", (unsigned long)shrink);
+            printf("  %-16s %7s %7s %7lu %11s\n", entry->name, "-", "-",
+                   (unsigned long)free_bytes, shrink_text);
+        }
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,92 @@
+/******************************************************************************
+* File Name: rtos_stats.h
+*
+* Description: This file contains declarations of the FreeRTOS run-time
+* statistics sampler, its telemetry and the stack sizing report.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_RTOS_STATS_H_
+#define SOURCE_RTOS_STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cy_result.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Result codes */
+#define RTOS_STATS_RSLT_MODULE              (CY_RSLT_MODULE_MIDDLEWARE_BASE + 0xF4u)
+#define RTOS_STATS_RSLT_ERR_NOMEM           CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, RTOS_STATS_RSLT_MODULE, 1)
+#define RTOS_STATS_RSLT_ERR_TIMER           CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, RTOS_STATS_RSLT_MODULE, 2)
+
+/* Frequency of the run-time counter */
+#define RTOS_STATS_TIMER_HZ                 (1000000u)
+
+/* Tasks reported per sample; the rest are left out */
+#ifndef RTOS_STATS_MAX_TASKS
+#define RTOS_STATS_MAX_TASKS                (24u)
+#endif
+
+/* Version of the telemetry message, see rtos_stats.c */
+#define RTOS_STATS_MSG_VERSION              (1u)
+
+/* Tasks tracked by the stack sizing report */
+#ifndef RTOS_STATS_MAX_STACKS
+#define RTOS_STATS_MAX_STACKS               (RTOS_STATS_MAX_TASKS)
+#endif
+
+/* Safety margin of a recommended stack size: a share of the peak use, but
+ * at least RTOS_STATS_STACK_MIN_MARGIN bytes. Sizes are rounded up to
+ * RTOS_STATS_STACK_ALIGN bytes. */
+#ifndef RTOS_STATS_STACK_MARGIN_PCT
+#define RTOS_STATS_STACK_MARGIN_PCT         (25u)
+#endif
+#ifndef RTOS_STATS_STACK_MIN_MARGIN
+#define RTOS_STATS_STACK_MIN_MARGIN         (256u)
+#endif
+#define RTOS_STATS_STACK_ALIGN              (256u)
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+void rtos_stats_timer_init(void);
+uint32_t rtos_stats_timer_read(void);
+bool rtos_stats_timer_ready(void);
+cy_rslt_t rtos_stats_start(const char *topic, uint32_t period_ms);
+void rtos_stats_stack_register(const char *task_name, uint32_t stack_words);
+void rtos_stats_stack_checkpoint(void);
+void rtos_stats_stack_report(void);
+
+#endif /* SOURCE_RTOS_STATS_H_ */
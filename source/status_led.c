@@ -0,0 +1,235 @@
+/******************************************************************************
+* File Name: status_led.c
+*
+* Description: This file contains the status LED. A FreeRTOS software timer
+* steps through a blink pattern per state, so the LED needs no task of its
+* own and the CPU only wakes up at the edges of the pattern.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+
+/* FreeRTOS header files */
+#include <FreeRTOS.h>
+#include <timers.h>
+
+#include "conn_trace.h"
+#include "status_led.h"
+
+/**********************************************
+ * Other configuration
+ *********************************************/
+/* User LED blink delay while idle */
+#define BLINKY_DELAY_MS     (1000)
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Blink half-period while downloading: STATUS_LED_RATE_SCALE divided by the
+ * throughput in KB/s, within the limits below */
+#define STATUS_LED_RATE_SCALE               (2000u)
+#define STATUS_LED_RATE_MIN_MS              (50u)
+#define STATUS_LED_RATE_MAX_MS              (500u)
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* On and off times of each pattern in ms, starting with on. A pattern repeats
+ * at its 0 entry. */
+static const uint16_t status_led_idle[] = { BLINKY_DELAY_MS, BLINKY_DELAY_MS, 0 };
+static const uint16_t status_led_connecting[] = { 100, 100, 100, 700, 0 };
+static const uint16_t status_led_failed[] = { 100, 100, 100, 100, 100, 1500, 0 };
+
+static const uint16_t * const status_led_patterns[STATUS_LED_STATE_MAX] =
+{
+    [STATUS_LED_IDLE] = status_led_idle,
+    [STATUS_LED_CONNECTING] = status_led_connecting,
+    [STATUS_LED_DOWNLOADING] = NULL,                /* Follows the throughput */
+    [STATUS_LED_VERIFYING] = NULL,                  /* Steady on */
+    [STATUS_LED_FAILED] = status_led_failed
+};
+
+static TimerHandle_t status_led_timer;
+
+/* State set by the application, read by the timer */
+static volatile status_led_state_t status_led_requested = STATUS_LED_CONNECTING;
+
+/* Pattern position, only used by the timer */
+static status_led_state_t status_led_shown = STATUS_LED_STATE_MAX;
+static uint32_t status_led_step_index;
+static uint32_t status_led_rx_bytes;
+static TickType_t status_led_rx_tick;
+static uint32_t status_led_rate;
+
+/*******************************************************************************
+ * Function Name: status_led_download_step
+ *******************************************************************************
+ * Summary:
+ *  Returns the blink half-period for the download throughput since the last
+ *  step, smoothed over a few steps.
+ *
+ *******************************************************************************/
+static uint32_t status_led_download_step(void)
+{
+    uint32_t rx_bytes = conn_trace_rx_bytes();
+    TickType_t now = xTaskGetTickCount();
+    uint32_t elapsed_ms = (uint32_t)((now - status_led_rx_tick) * portTICK_PERIOD_MS);
+    uint32_t step_ms = STATUS_LED_RATE_MAX_MS;
+
+    if (elapsed_ms > 0u)
+    {
+        /* Bytes per second, averaged with the previous steps */
+        status_led_rate = ((status_led_rate * 3u) + (((rx_bytes - status_led_rx_bytes) * 1000u) / elapsed_ms)) / 4u;
+    }
+    status_led_rx_bytes = rx_bytes;
+    status_led_rx_tick = now;
+
+    if ((status_led_rate / 1024u) > 0u)
+    {
+        step_ms = STATUS_LED_RATE_SCALE / (status_led_rate / 1024u);
+    }
+
+    return (step_ms < STATUS_LED_RATE_MIN_MS) ? STATUS_LED_RATE_MIN_MS :
+           (step_ms > STATUS_LED_RATE_MAX_MS) ? STATUS_LED_RATE_MAX_MS : step_ms;
+}
+
+/*******************************************************************************
+ * Function Name: status_led_step
+ *******************************************************************************
+ * Summary:
+ *  Timer callback. Sets the LED for the next step of the pattern of the
+ *  current state and rearms the timer for the length of the step.
+ *
+ *******************************************************************************/
+static void status_led_step(TimerHandle_t timer)
+{
+    status_led_state_t state = status_led_requested;
+    const uint16_t *pattern = status_led_patterns[state];
+    uint32_t step_ms;
+
+    if (state != status_led_shown)
+    {
+        status_led_shown = state;
+        status_led_step_index = 0u;
+        status_led_rx_bytes = conn_trace_rx_bytes();
+        status_led_rx_tick = xTaskGetTickCount();
+        status_led_rate = 0u;
+    }
+
+    if (state == STATUS_LED_VERIFYING)
+    {
+        /* Held until the next state change restarts the timer */
+        cyhal_gpio_write(CYBSP_USER_LED, CYBSP_LED_STATE_ON);
+        return;
+    }
+
+    if (pattern == NULL)
+    {
+        step_ms = status_led_download_step();
+    }
+    else
+    {
+        if (pattern[status_led_step_index] == 0u)
+        {
+            status_led_step_index = 0u;
+        }
+        step_ms = pattern[status_led_step_index];
+    }
+
+    cyhal_gpio_write(CYBSP_USER_LED,
+                     ((status_led_step_index % 2u) == 0u) ? CYBSP_LED_STATE_ON : CYBSP_LED_STATE_OFF);
+    status_led_step_index++;
+
+    (void)xTimerChangePeriod(timer, pdMS_TO_TICKS(step_ms), 0);
+}
+
+/*******************************************************************************
+ * Function Name: status_led_init
+ *******************************************************************************
+ * Summary:
+ *  Initializes the user LED and starts showing STATUS_LED_CONNECTING. May be
+ *  called before the scheduler starts.
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, STATUS_LED_RSLT_ERR_NOMEM or a GPIO error
+ *
+ *******************************************************************************/
+cy_rslt_t status_led_init(void)
+{
+    cy_rslt_t result;
+
+    result = cyhal_gpio_init(CYBSP_USER_LED, CYHAL_GPIO_DIR_OUTPUT,
+                             CYHAL_GPIO_DRIVE_PULLUP, CYBSP_LED_STATE_OFF);
+    if (result != CY_RSLT_SUCCESS)
+    {
+        return result;
+    }
+
+    status_led_timer = xTimerCreate("STATUS LED", pdMS_TO_TICKS(1), pdFALSE, NULL, status_led_step);
+    if ((status_led_timer == NULL) || (xTimerStart(status_led_timer, 0) != pdPASS))
+    {
+        return STATUS_LED_RSLT_ERR_NOMEM;
+    }
+
+    return CY_RSLT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: status_led_set_state
+ *******************************************************************************
+ * Summary:
+ *  Switches the LED to the pattern of a state. Repeating the current state
+ *  does not restart its pattern.
+ *
+ * Parameters:
+ *  status_led_state_t state : State to show
+ *
+ *******************************************************************************/
+void status_led_set_state(status_led_state_t state)
+{
+    if ((state >= STATUS_LED_STATE_MAX) || (state == status_led_requested))
+    {
+        return;
+    }
+
+    status_led_requested = state;
+    if (status_led_timer != NULL)
+    {
+        /* Run the timer at once to start the new pattern */
+        (void)xTimerChangePeriod(status_led_timer, 1, 0);
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,71 @@
+/******************************************************************************
+* File Name: status_led.h
+*
+* Description: This file contains declarations of the status LED, which shows
+* the state of the OTA agent.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_STATUS_LED_H_
+#define SOURCE_STATUS_LED_H_
+
+#include "cy_result.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Result codes */
+#define STATUS_LED_RSLT_MODULE              (CY_RSLT_MODULE_MIDDLEWARE_BASE + 0xF6u)
+#define STATUS_LED_RSLT_ERR_NOMEM           CY_RSLT_CREATE(CY_RSLT_TYPE_ERROR, STATUS_LED_RSLT_MODULE, 1)
+
+/*******************************************************************************
+* Data structures and enumerations
+********************************************************************************/
+/* States shown by the LED */
+typedef enum
+{
+    STATUS_LED_IDLE = 0,        /* Waiting for the next update check */
+    STATUS_LED_CONNECTING,      /* Joining the network or connecting to the broker */
+    STATUS_LED_DOWNLOADING,     /* Receiving an image; the blink rate follows the throughput */
+    STATUS_LED_VERIFYING,       /* Image received, being verified; steady on */
+    STATUS_LED_FAILED,          /* The last update check failed */
+    STATUS_LED_STATE_MAX
+} status_led_state_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t status_led_init(void);
+void status_led_set_state(status_led_state_t state);
+
+#endif /* SOURCE_STATUS_LED_H_ */
@@ -0,0 +1,759 @@
+/******************************************************************************
+* File Name: wifi_connect.c
+*
+* Description: This file contains functions used to join the Wi-Fi AP. After
+* every successful join the BSSID, channel and pairwise master key (PMK) of the
+* AP are cached in flash. On the next boot, and in particular on the reboot
+* that follows an OTA update, the cached values are used for a directed join
+* that skips the SSID scan and the PBKDF2 passphrase hashing. A full join is
+* used as the fallback whenever the fast path fails.
+*
+* Failed joins are classified (AP not found, authentication, DHCP, other) and
+* retried with a separate exponential backoff for each class. Every delay is
+* randomized so that devices which lost the same AP do not retry in lockstep.
+*
+* Right before an intentional reboot the DHCP lease, DNS servers and gateway
+* MAC address are saved as well. The next boot brings the interface up with
+* that lease straight away, pre-seeds the gateway ARP entry and only then lets
+* DHCP revalidate the lease in the background.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+/* Header file includes */
+#include "cyhal.h"
+#include "cybsp.h"
+#include "cy_retarget_io.h"
+#include <string.h>
+
+/* Wi-Fi connection manager header files. */
+#include "cy_wcm.h"
+#include "whd_wifi_api.h"
+#include "whd_types.h"
+
+/* lwIP header files */
+#include "lwip/netif.h"
+#include "lwip/tcpip.h"
+#include "lwip/dhcp.h"
+#include "lwip/dns.h"
+#include "lwip/etharp.h"
+#include "lwip/timeouts.h"
+
+/* PBKDF2 used to derive the PMK */
+#include "mbedtls/md.h"
+#include "mbedtls/pkcs5.h"
+
+/* FreeRTOS header file */
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "app_nvm.h"
+#include "wifi_connect.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Bump when the layout of wifi_cache_t changes */
+#define WIFI_CACHE_VERSION                  (1u)
+
+/* Length of the PMK and of its hexadecimal representation */
+#define WIFI_PMK_LEN                        (32u)
+#define WIFI_PMK_HEX_LEN                    (WIFI_PMK_LEN * 2u)
+
+/* Iteration count defined by IEEE 802.11i for the passphrase to PMK mapping */
+#define WIFI_PMK_PBKDF2_ITERATIONS          (4096u)
+
+/* Highest 2.4 GHz channel number */
+#define WIFI_MAX_2_4GHZ_CHANNEL             (14u)
+
+/* Bump when the layout of wifi_lease_t changes */
+#define WIFI_LEASE_VERSION                  (1u)
+
+/* A saved lease is only reused if at least this much of it is left */
+#ifndef WIFI_LEASE_MIN_REMAINING_SECS
+#define WIFI_LEASE_MIN_REMAINING_SECS       (10u * 60u)
+#endif
+
+/* Time after which the pre-seeded gateway ARP entry is handed back to ARP */
+#ifndef WIFI_SEEDED_ARP_HOLD_MS
+#define WIFI_SEEDED_ARP_HOLD_MS             (60u * 1000u)
+#endif
+
+/*******************************************************************************
+* Data structures
+********************************************************************************/
+/* States of the connection state machine */
+typedef enum
+{
+    WIFI_STATE_FAST_JOIN,
+    WIFI_STATE_FULL_JOIN,
+    WIFI_STATE_BACKOFF,
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_FAILED
+} wifi_state_t;
+
+/* Backoff curve of a failure class */
+typedef struct
+{
+    const char *name;
+    uint32_t base_ms;
+    uint32_t max_ms;
+} wifi_backoff_t;
+
+/* Join parameters of the last successful connection */
+typedef struct
+{
+    uint32_t version;
+    uint32_t config_crc;                        /* CRC of the SSID, password and security it was learned with */
+    cy_wcm_mac_t bssid;
+    uint8_t channel;
+    uint8_t has_pmk;
+    char pmk_hex[WIFI_PMK_HEX_LEN + 1u];        /* PMK as 64 hex digits, accepted by the WLAN firmware as a PSK */
+} wifi_cache_t;
+
+/* Network configuration saved right before an intentional reboot */
+typedef struct
+{
+    uint32_t version;
+    uint32_t config_crc;                        /* CRC of the credentials of the network it belongs to */
+    uint32_t remaining_secs;                    /* Lease time left when it was saved */
+    uint32_t ip;                                /* IPv4 addresses, network byte order */
+    uint32_t netmask;
+    uint32_t gateway;
+    uint32_t dns[DNS_MAX_SERVERS];
+    uint8_t gateway_mac[ETH_HWADDR_LEN];
+    uint8_t has_gateway_mac;
+    uint8_t reserved;
+} wifi_lease_t;
+
+/*******************************************************************************
+* Global Variables
+********************************************************************************/
+/* Credentials fingerprint of the current connection, 0 when not connected */
+static uint32_t wifi_active_config_crc;
+
+/* Gateway ARP entry added from a saved lease */
+static ip4_addr_t wifi_seeded_gateway;
+
+/* Backoff curves, indexed by wifi_failure_t */
+static const wifi_backoff_t wifi_backoff[WIFI_FAILURE_MAX] =
+{
+    [WIFI_FAILURE_NONE]         = { "none",             0u,                         0u                         },
+    [WIFI_FAILURE_AP_NOT_FOUND] = { "AP not found",     WIFI_BACKOFF_NO_AP_BASE_MS, WIFI_BACKOFF_NO_AP_MAX_MS  },
+    [WIFI_FAILURE_AUTH]         = { "auth failure",     WIFI_BACKOFF_AUTH_BASE_MS,  WIFI_BACKOFF_AUTH_MAX_MS   },
+    [WIFI_FAILURE_DHCP]         = { "DHCP timeout",     WIFI_BACKOFF_DHCP_BASE_MS,  WIFI_BACKOFF_DHCP_MAX_MS   },
+    [WIFI_FAILURE_CONFIG]       = { "bad config",       0u,                         0u                         },
+    [WIFI_FAILURE_OTHER]        = { "other",            WIFI_BACKOFF_OTHER_BASE_MS, WIFI_BACKOFF_OTHER_MAX_MS  },
+};
+
+/* State of the jitter generator */
+static uint32_t wifi_jitter_state;
+
+/*******************************************************************************
+ * Function Name: wifi_config_crc
+ *******************************************************************************
+ * Summary:
+ *  Fingerprints the user configured credentials so that a cache entry learned
+ *  with different credentials is never used.
+ *
+ *******************************************************************************/
+static uint32_t wifi_config_crc(const cy_wcm_connect_params_t *params)
+{
+    return app_nvm_crc32(&params->ap_credentials, sizeof(params->ap_credentials));
+}
+
+/*******************************************************************************
+ * Function Name: wifi_security_uses_passphrase
+ *******************************************************************************
+ * Summary:
+ *  Returns true for the WPA/WPA2 personal security types, where the PMK is
+ *  derived from the passphrase and can therefore be cached.
+ *
+ *******************************************************************************/
+static bool wifi_security_uses_passphrase(cy_wcm_security_t security)
+{
+    switch (security)
+    {
+        case CY_WCM_SECURITY_WPA_TKIP_PSK:
+        case CY_WCM_SECURITY_WPA_AES_PSK:
+        case CY_WCM_SECURITY_WPA_MIXED_PSK:
+        case CY_WCM_SECURITY_WPA2_AES_PSK:
+        case CY_WCM_SECURITY_WPA2_TKIP_PSK:
+        case CY_WCM_SECURITY_WPA2_MIXED_PSK:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: wifi_derive_pmk
+ *******************************************************************************
+ * Summary:
+ *  Derives the PMK from the passphrase and SSID (PBKDF2-HMAC-SHA1, 4096
+ *  iterations) and stores it as hexadecimal digits. This costs about as much
+ *  as the WLAN firmware spends on it during every join, but it is done only
+ *  once, after the device is already connected.
+ *
+ *******************************************************************************/
+static bool wifi_derive_pmk(const cy_wcm_connect_params_t *params, char *pmk_hex)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *passphrase = (const char *)params->ap_credentials.password;
+    const char *ssid = (const char *)params->ap_credentials.SSID;
+    uint8_t pmk[WIFI_PMK_LEN];
+    mbedtls_md_context_t md_ctx;
+    int ret;
+
+    /* A 64 digit password already is a PSK */
+    if (strlen(passphrase) >= WIFI_PMK_HEX_LEN)
+    {
+        return false;
+    }
+
+    mbedtls_md_init(&md_ctx);
+    ret = mbedtls_md_setup(&md_ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA1), 1);
+    if (ret == 0)
+    {
+        ret = mbedtls_pkcs5_pbkdf2_hmac(&md_ctx, (const unsigned char *)passphrase, strlen(passphrase),
+                                        (const unsigned char *)ssid, strlen(ssid),
+                                        WIFI_PMK_PBKDF2_ITERATIONS, sizeof(pmk), pmk);
+    }
+    mbedtls_md_free(&md_ctx);
+
+    if (ret != 0)
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < WIFI_PMK_LEN; i++)
+    {
+        pmk_hex[2u * i] = hex[pmk[i] >> 4];
+        pmk_hex[(2u * i) + 1u] = hex[pmk[i] & 0x0Fu];
+    }
+    pmk_hex[WIFI_PMK_HEX_LEN] = '\0';
+    memset(pmk, 0, sizeof(pmk));
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: wifi_cache_update
+ *******************************************************************************
+ * Summary:
+ *  Reads the BSSID and channel of the associated AP from the WLAN driver and
+ *  saves them, together with the PMK, for the next boot.
+ *
+ *******************************************************************************/
+static void wifi_cache_update(const cy_wcm_connect_params_t *params, const wifi_cache_t *old_cache)
+{
+    wifi_cache_t cache;
+    whd_interface_t whd_iface;
+    whd_mac_t bssid;
+    uint32_t channel = 0;
+    cy_rslt_t result;
+
+    memset(&cache, 0, sizeof(cache));
+    cache.version = WIFI_CACHE_VERSION;
+    cache.config_crc = wifi_config_crc(params);
+
+    LOCK_TCPIP_CORE();
+    whd_iface = (netif_default != NULL) ? (whd_interface_t)netif_default->state : NULL;
+    UNLOCK_TCPIP_CORE();
+
+    if ((whd_iface == NULL) ||
+        (whd_wifi_get_bssid(whd_iface, &bssid) != WHD_SUCCESS) ||
+        (whd_wifi_get_channel(whd_iface, &channel) != WHD_SUCCESS))
+    {
+        printf("Unable to read the AP BSSID and channel, fast rejoin disabled.\n");
+        return;
+    }
+    memcpy(cache.bssid, bssid.octet, sizeof(cache.bssid));
+    cache.channel = (uint8_t)channel;
+
+    /* The PMK only depends on the SSID and passphrase, so keep it if those did not change */
+    if ((old_cache != NULL) && (old_cache->has_pmk != 0u))
+    {
+        memcpy(cache.pmk_hex, old_cache->pmk_hex, sizeof(cache.pmk_hex));
+        cache.has_pmk = 1u;
+    }
+    else if (wifi_security_uses_passphrase(params->ap_credentials.security))
+    {
+        cache.has_pmk = wifi_derive_pmk(params, cache.pmk_hex) ? 1u : 0u;
+    }
+
+    result = app_nvm_write(APP_NVM_ID_WIFI_CACHE, &cache, sizeof(cache));
+    if (result != CY_RSLT_SUCCESS)
+    {
+        printf("Failed to save the Wi-Fi cache. Error: 0x%08lx\n", (unsigned long)result);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: wifi_fast_rejoin
+ *******************************************************************************
+ * Summary:
+ *  Attempts a single directed join with the cached BSSID, band and PMK.
+ *
+ *******************************************************************************/
+static cy_rslt_t wifi_fast_rejoin(const cy_wcm_connect_params_t *params, const wifi_cache_t *cache,
+                                  cy_wcm_ip_address_t *ip_address)
+{
+    cy_wcm_connect_params_t fast_param;
+
+    memcpy(&fast_param, params, sizeof(fast_param));
+    memcpy(fast_param.BSSID, cache->bssid, sizeof(fast_param.BSSID));
+
+    /* The connection manager has no channel parameter; restrict the join to its band instead */
+    fast_param.band = (cache->channel > WIFI_MAX_2_4GHZ_CHANNEL) ? CY_WCM_WIFI_BAND_5GHZ : CY_WCM_WIFI_BAND_2_4GHZ;
+
+    if (cache->has_pmk != 0u)
+    {
+        memset(fast_param.ap_credentials.password, 0, sizeof(fast_param.ap_credentials.password));
+        memcpy(fast_param.ap_credentials.password, cache->pmk_hex, WIFI_PMK_HEX_LEN);
+    }
+
+    return cy_wcm_connect_ap(&fast_param, ip_address);
+}
+
+/*******************************************************************************
+ * Function Name: wifi_classify_failure
+ *******************************************************************************
+ * Summary:
+ *  Maps the result of a failed join to a failure class.
+ *
+ *******************************************************************************/
+static wifi_failure_t wifi_classify_failure(cy_rslt_t result)
+{
+    switch (result)
+    {
+        case WHD_NETWORK_NOT_FOUND:
+            return WIFI_FAILURE_AP_NOT_FOUND;
+
+        case WHD_NOT_AUTHENTICATED:
+        case WHD_INVALID_KEY:
+        case WHD_EAPOL_KEY_PACKET_M1_TIMEOUT:
+        case WHD_EAPOL_KEY_PACKET_M3_TIMEOUT:
+        case WHD_EAPOL_KEY_PACKET_G1_TIMEOUT:
+        case WHD_EAPOL_KEY_FAILURE:
+            return WIFI_FAILURE_AUTH;
+
+        case CY_RSLT_WCM_DHCP_TIMEOUT:
+            return WIFI_FAILURE_DHCP;
+
+        case CY_RSLT_WCM_BAD_NETWORK_PARAM:
+        case CY_RSLT_WCM_BAD_SSID_LEN:
+        case CY_RSLT_WCM_BAD_PASSPHRASE_LEN:
+        case CY_RSLT_WCM_SECURITY_NOT_SUPPORTED:
+            return WIFI_FAILURE_CONFIG;
+
+        default:
+            return WIFI_FAILURE_OTHER;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: wifi_jitter_random
+ *******************************************************************************
+ * Summary:
+ *  Returns a pseudo random number for the backoff jitter. The generator is
+ *  seeded from the TRNG so that every device draws a different sequence.
+ *
+ *******************************************************************************/
+static uint32_t wifi_jitter_random(void)
+{
+    cyhal_trng_t trng;
+
+    if (wifi_jitter_state == 0u)
+    {
+        if (cyhal_trng_init(&trng) == CY_RSLT_SUCCESS)
+        {
+            wifi_jitter_state = cyhal_trng_generate(&trng);
+            cyhal_trng_free(&trng);
+        }
+        wifi_jitter_state |= 1u;
+    }
+
+    /* xorshift32 */
+    wifi_jitter_state ^= wifi_jitter_state << 13;
+    wifi_jitter_state ^= wifi_jitter_state >> 17;
+    wifi_jitter_state ^= wifi_jitter_state << 5;
+
+    return wifi_jitter_state;
+}
+
+/*******************************************************************************
+ * Function Name: wifi_backoff_delay_ms
+ *******************************************************************************
+ * Summary:
+ *  Computes the delay before the next attempt: the ceiling doubles with every
+ *  consecutive failure of the same class up to the class maximum, and the
+ *  delay is drawn uniformly between the class base and that ceiling.
+ *
+ *******************************************************************************/
+static uint32_t wifi_backoff_delay_ms(wifi_failure_t failure, uint32_t streak)
+{
+    const wifi_backoff_t *curve = &wifi_backoff[failure];
+    uint32_t ceiling = curve->base_ms;
+
+    while ((streak-- > 1u) && (ceiling < curve->max_ms))
+    {
+        ceiling *= 2u;
+    }
+    if (ceiling > curve->max_ms)
+    {
+        ceiling = curve->max_ms;
+    }
+
+    return curve->base_ms + (wifi_jitter_random() % (ceiling - curve->base_ms + 1u));
+}
+
+/*******************************************************************************
+ * Function Name: wifi_lease_load
+ *******************************************************************************
+ * Summary:
+ *  Reads the lease saved by the previous boot and consumes it, so that a lease
+ *  is never used for more than one boot. Fills static_ip with it when it
+ *  belongs to the configured network and has enough time left.
+ *
+ *******************************************************************************/
+static bool wifi_lease_load(const cy_wcm_connect_params_t *params, wifi_lease_t *lease,
+                            cy_wcm_ip_setting_t *static_ip)
+{
+    if ((app_nvm_read(APP_NVM_ID_NET_LEASE, lease, sizeof(*lease)) != CY_RSLT_SUCCESS))
+    {
+        return false;
+    }
+
+    (void)app_nvm_erase(APP_NVM_ID_NET_LEASE);
+
+    if ((lease->version != WIFI_LEASE_VERSION) || (lease->config_crc != wifi_config_crc(params)) ||
+        (lease->remaining_secs < WIFI_LEASE_MIN_REMAINING_SECS) || (lease->ip == 0u))
+    {
+        return false;
+    }
+
+    memset(static_ip, 0, sizeof(*static_ip));
+    static_ip->ip_address.version = CY_WCM_IP_VER_V4;
+    static_ip->ip_address.ip.v4 = lease->ip;
+    static_ip->netmask.version = CY_WCM_IP_VER_V4;
+    static_ip->netmask.ip.v4 = lease->netmask;
+    static_ip->gateway.version = CY_WCM_IP_VER_V4;
+    static_ip->gateway.ip.v4 = lease->gateway;
+
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: wifi_seeded_arp_release
+ *******************************************************************************
+ * Summary:
+ *  lwIP timeout handler that turns the pre-seeded gateway entry back into a
+ *  regular, ageing ARP entry. Runs in the TCP/IP thread.
+ *
+ *******************************************************************************/
+static void wifi_seeded_arp_release(void *arg)
+{
+    (void)arg;
+    (void)etharp_remove_static_entry(&wifi_seeded_gateway);
+}
+
+/*******************************************************************************
+ * Function Name: wifi_lease_apply
+ *******************************************************************************
+ * Summary:
+ *  Completes the bring-up with a saved lease: restores the DNS servers, seeds
+ *  the gateway ARP entry and revalidates the lease with DHCP while the
+ *  application already uses the interface. DHCP goes through INIT-REBOOT, a
+ *  REQUEST for the saved address, instead of DISCOVER, so the server either
+ *  confirms the address in use or refuses it. On a refusal, lwIP drops the
+ *  address, which aborts the connections bound to it, and runs discovery;
+ *  the application then reconnects with the new address.
+ *
+ *******************************************************************************/
+static void wifi_lease_apply(const wifi_lease_t *lease)
+{
+    ip_addr_t dns_server;
+    struct eth_addr gateway_mac;
+    struct dhcp *dhcp;
+
+    LOCK_TCPIP_CORE();
+
+    for (uint32_t i = 0; i < DNS_MAX_SERVERS; i++)
+    {
+        if (lease->dns[i] != 0u)
+        {
+            ip_addr_set_ip4_u32(&dns_server, lease->dns[i]);
+            dns_setserver((u8_t)i, &dns_server);
+        }
+    }
+
+    if (lease->has_gateway_mac != 0u)
+    {
+        ip4_addr_set_u32(&wifi_seeded_gateway, lease->gateway);
+        memcpy(gateway_mac.addr, lease->gateway_mac, ETH_HWADDR_LEN);
+        if (etharp_add_static_entry(&wifi_seeded_gateway, &gateway_mac) == ERR_OK)
+        {
+            sys_timeout(WIFI_SEEDED_ARP_HOLD_MS, wifi_seeded_arp_release, NULL);
+        }
+    }
+
+    /* dhcp_start() also sends a DISCOVER; the OFFER it draws is ignored
+     * once the client is rebooting */
+    if ((netif_default != NULL) && (dhcp_start(netif_default) == ERR_OK))
+    {
+        /* Restore the client as bound to the saved address, so that the
+         * network change below sends a REQUEST for it (INIT-REBOOT) */
+        dhcp = netif_dhcp_data(netif_default);
+        ip4_addr_set_u32(&dhcp->offered_ip_addr, lease->ip);
+        dhcp->state = DHCP_STATE_BOUND;
+        dhcp_network_changed(netif_default);
+    }
+
+    UNLOCK_TCPIP_CORE();
+}
+
+/*******************************************************************************
+ * Function Name: wifi_connect_save_lease
+ *******************************************************************************
+ * Summary:
+ *  Saves the current DHCP lease, DNS servers and gateway MAC address so that
+ *  the next boot can bring the network up without DHCP discovery and ARP.
+ *  Call right before an intentional reboot, e.g. the one after an OTA update.
+ *
+ *******************************************************************************/
+void wifi_connect_save_lease(void)
+{
+    wifi_lease_t lease;
+    struct netif *netif;
+    struct dhcp *dhcp;
+    struct eth_addr *eth_ret;
+    const ip4_addr_t *ip_ret;
+    uint32_t lease_used_secs;
+
+    if ((wifi_active_config_crc == 0u) || (app_nvm_init() != CY_RSLT_SUCCESS))
+    {
+        return;
+    }
+
+    memset(&lease, 0, sizeof(lease));
+    lease.version = WIFI_LEASE_VERSION;
+    lease.config_crc = wifi_active_config_crc;
+
+    LOCK_TCPIP_CORE();
+
+    netif = netif_default;
+    dhcp = (netif != NULL) ? netif_dhcp_data(netif) : NULL;
+    if ((dhcp != NULL) && dhcp_supplied_address(netif))
+    {
+        lease.ip = ip4_addr_get_u32(netif_ip4_addr(netif));
+        lease.netmask = ip4_addr_get_u32(netif_ip4_netmask(netif));
+        lease.gateway = ip4_addr_get_u32(netif_ip4_gw(netif));
+
+        lease_used_secs = (uint32_t)dhcp->lease_used * DHCP_COARSE_TIMER_SECS;
+        lease.remaining_secs = (dhcp->offered_t0_lease > lease_used_secs) ?
+                               (dhcp->offered_t0_lease - lease_used_secs) : 0u;
+
+        for (uint32_t i = 0; i < DNS_MAX_SERVERS; i++)
+        {
+            const ip_addr_t *dns_server = dns_getserver((u8_t)i);
+            if (IP_IS_V4(dns_server))
+            {
+                lease.dns[i] = ip4_addr_get_u32(ip_2_ip4(dns_server));
+            }
+        }
+
+        if (etharp_find_addr(netif, netif_ip4_gw(netif), &eth_ret, &ip_ret) >= 0)
+        {
+            memcpy(lease.gateway_mac, eth_ret->addr, ETH_HWADDR_LEN);
+            lease.has_gateway_mac = 1u;
+        }
+    }
+
+    UNLOCK_TCPIP_CORE();
+
+    if (lease.ip != 0u)
+    {
+        (void)app_nvm_write(APP_NVM_ID_NET_LEASE, &lease, sizeof(lease));
+    }
+}
+
+/*******************************************************************************
+ * Function Name: wifi_connect_ap
+ *******************************************************************************
+ * Summary:
+ *  Connects to the Wi-Fi AP and keeps trying until it succeeds. With
+ *  WIFI_CONNECT_FLAG_FAST_REJOIN and a cache entry learned with the same
+ *  credentials, a directed join is tried first. With
+ *  WIFI_CONNECT_FLAG_REUSE_LEASE, a lease saved by wifi_connect_save_lease()
+ *  replaces DHCP discovery on the first attempt. Failed attempts are retried
+ *  with the backoff curve of their failure class. The Wi-Fi connection
+ *  manager must be initialized by the caller.
+ *
+ * Parameters:
+ *  const cy_wcm_connect_params_t *params : SSID, password and security of the AP
+ *  uint32_t flags                        : WIFI_CONNECT_FLAG_xxx options
+ *
+ * Return:
+ *  cy_rslt_t : CY_RSLT_SUCCESS, or the join error if the configuration is
+ *              invalid and retrying cannot help
+ *
+ *******************************************************************************/
+cy_rslt_t wifi_connect_ap(const cy_wcm_connect_params_t *params, uint32_t flags)
+{
+    cy_wcm_connect_params_t join_param;
+    cy_wcm_ip_setting_t static_ip;
+    cy_wcm_ip_address_t ip_address;
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+    wifi_cache_t cache;
+    wifi_lease_t lease;
+    wifi_state_t state = WIFI_STATE_FULL_JOIN;
+    wifi_failure_t failure = WIFI_FAILURE_NONE;
+    wifi_failure_t last_failure = WIFI_FAILURE_NONE;
+    uint32_t streak = 0;
+    uint32_t delay_ms;
+    bool fast_rejoin = ((flags & WIFI_CONNECT_FLAG_FAST_REJOIN) != 0u);
+    bool lease_valid = false;
+    bool cache_valid = false;
+    bool fast_joined = false;
+    TickType_t start_ticks = xTaskGetTickCount();
+
+    memcpy(&join_param, params, sizeof(join_param));
+    wifi_active_config_crc = 0u;
+
+    if ((flags != 0u) && (app_nvm_init() != CY_RSLT_SUCCESS))
+    {
+        flags = 0u;
+        fast_rejoin = false;
+    }
+
+    if (fast_rejoin &&
+        (app_nvm_read(APP_NVM_ID_WIFI_CACHE, &cache, sizeof(cache)) == CY_RSLT_SUCCESS) &&
+        (cache.version == WIFI_CACHE_VERSION) && (cache.config_crc == wifi_config_crc(params)))
+    {
+        cache_valid = true;
+        state = WIFI_STATE_FAST_JOIN;
+    }
+
+    /* Bring the interface up with the saved lease instead of running DHCP discovery */
+    if (((flags & WIFI_CONNECT_FLAG_REUSE_LEASE) != 0u) && wifi_lease_load(params, &lease, &static_ip))
+    {
+        join_param.static_ip_settings = &static_ip;
+        lease_valid = true;
+    }
+
+    while ((state != WIFI_STATE_CONNECTED) && (state != WIFI_STATE_FAILED))
+    {
+        switch (state)
+        {
+            case WIFI_STATE_FAST_JOIN:
+                result = wifi_fast_rejoin(&join_param, &cache, &ip_address);
+                if (result == CY_RSLT_SUCCESS)
+                {
+                    fast_joined = true;
+                    state = WIFI_STATE_CONNECTED;
+                }
+                else
+                {
+                    /* Go straight to a full join; the cached AP may simply be gone */
+                    printf("Fast rejoin failed with error code 0x%08lx. Falling back to a full join...\n",
+                           (unsigned long)result);
+                    state = WIFI_STATE_FULL_JOIN;
+                }
+                break;
+
+            case WIFI_STATE_FULL_JOIN:
+                result = cy_wcm_connect_ap( &join_param, &ip_address );
+                if (result == CY_RSLT_SUCCESS)
+                {
+                    state = WIFI_STATE_CONNECTED;
+                    break;
+                }
+
+                failure = wifi_classify_failure(result);
+                streak = (failure == last_failure) ? (streak + 1u) : 1u;
+                last_failure = failure;
+                state = (failure == WIFI_FAILURE_CONFIG) ? WIFI_STATE_FAILED : WIFI_STATE_BACKOFF;
+                break;
+
+            case WIFI_STATE_BACKOFF:
+                delay_ms = wifi_backoff_delay_ms(failure, streak);
+                printf( "Connection to Wi-Fi network failed with error code 0x%08lx (%s, %lu in a row). "
+                        "Retrying in %lu ms...\n", (unsigned long)result, wifi_backoff[failure].name,
+                        (unsigned long)streak, (unsigned long)delay_ms );
+                vTaskDelay(pdMS_TO_TICKS(delay_ms));
+
+                /* The saved lease may be what failed; use DHCP from now on */
+                join_param.static_ip_settings = NULL;
+                lease_valid = false;
+                state = WIFI_STATE_FULL_JOIN;
+                break;
+
+            default:
+                state = WIFI_STATE_FAILED;
+                break;
+        }
+    }
+
+    if (state == WIFI_STATE_FAILED)
+    {
+        printf( "Wi-Fi configuration rejected with error code 0x%08lx. Check WIFI_SSID, WIFI_PASSWORD and WIFI_SECURITY.\n",
+                (unsigned long)result );
+        return result;
+    }
+
+    wifi_active_config_crc = wifi_config_crc(params);
+
+    if (lease_valid)
+    {
+        wifi_lease_apply(&lease);
+    }
+
+    /* The scheduler starts right after reset, so the tick count is the boot-to-IP latency */
+    printf( "Successfully connected to Wi-Fi network '%s' in %lu ms (%s join, %s, %lu ms after boot).\n",
+            params->ap_credentials.SSID,
+            (unsigned long)((xTaskGetTickCount() - start_ticks) * portTICK_PERIOD_MS),
+            fast_joined ? "fast" : "full",
+            lease_valid ? "saved lease" : "DHCP",
+            (unsigned long)(xTaskGetTickCount() * portTICK_PERIOD_MS));
+
+    /* Refresh the cache after a full join; the AP or its channel may have changed */
+    if (fast_rejoin && !fast_joined)
+    {
+        wifi_cache_update(params, cache_valid ? &cache : NULL);
+    }
+
+    return result;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,110 @@
+/******************************************************************************
+* File Name: wifi_connect.h
+*
+* Description: This file contains declarations of the functions used to join
+* the Wi-Fi AP, including the fast rejoin and saved lease paths used after a
+* reboot.
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#ifndef SOURCE_WIFI_CONNECT_H_
+#define SOURCE_WIFI_CONNECT_H_
+
+#include "cy_wcm.h"
+#include <stdint.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Options of wifi_connect_ap() */
+#define WIFI_CONNECT_FLAG_FAST_REJOIN       (1u << 0)   /* Use and maintain the cached AP parameters */
+#define WIFI_CONNECT_FLAG_REUSE_LEASE       (1u << 1)   /* Use the lease saved by wifi_connect_save_lease() */
+
+/* Backoff curves of the failure classes. The delay before a retry is drawn
+ * at random between the base and a ceiling that doubles with every
+ * consecutive failure of the same class, up to the maximum.
+ */
+/* AP not found, e.g. while the AP reboots: retry soon, but spread the retries */
+#ifndef WIFI_BACKOFF_NO_AP_BASE_MS
+#define WIFI_BACKOFF_NO_AP_BASE_MS          (1000u)
+#endif
+#ifndef WIFI_BACKOFF_NO_AP_MAX_MS
+#define WIFI_BACKOFF_NO_AP_MAX_MS           (5u * 60u * 1000u)
+#endif
+
+/* Authentication failure, e.g. a wrong password: retrying rarely saves radio time */
+#ifndef WIFI_BACKOFF_AUTH_BASE_MS
+#define WIFI_BACKOFF_AUTH_BASE_MS           (30u * 1000u)
+#endif
+#ifndef WIFI_BACKOFF_AUTH_MAX_MS
+#define WIFI_BACKOFF_AUTH_MAX_MS            (30u * 60u * 1000u)
+#endif
+
+/* DHCP timeout: the link is up, so retry quickly */
+#ifndef WIFI_BACKOFF_DHCP_BASE_MS
+#define WIFI_BACKOFF_DHCP_BASE_MS           (2000u)
+#endif
+#ifndef WIFI_BACKOFF_DHCP_MAX_MS
+#define WIFI_BACKOFF_DHCP_MAX_MS            (60u * 1000u)
+#endif
+
+/* Any other failure */
+#ifndef WIFI_BACKOFF_OTHER_BASE_MS
+#define WIFI_BACKOFF_OTHER_BASE_MS          (1000u)
+#endif
+#ifndef WIFI_BACKOFF_OTHER_MAX_MS
+#define WIFI_BACKOFF_OTHER_MAX_MS           (2u * 60u * 1000u)
+#endif
+
+/*******************************************************************************
+* Data structures and enumerations
+********************************************************************************/
+/* Failure classes of a join attempt */
+typedef enum
+{
+    WIFI_FAILURE_NONE = 0,
+    WIFI_FAILURE_AP_NOT_FOUND,      /* No AP with the SSID (and BSSID) answered */
+    WIFI_FAILURE_AUTH,              /* Authentication or 4-way handshake failed */
+    WIFI_FAILURE_DHCP,              /* Associated, but no address was assigned */
+    WIFI_FAILURE_CONFIG,            /* Credentials rejected before any radio activity */
+    WIFI_FAILURE_OTHER,
+    WIFI_FAILURE_MAX
+} wifi_failure_t;
+
+/*******************************************************************************
+* Function Prototypes
+********************************************************************************/
+cy_rslt_t wifi_connect_ap(const cy_wcm_connect_params_t *params, uint32_t flags);
+void wifi_connect_save_lease(void);
+
+#endif /* SOURCE_WIFI_CONNECT_H_ */